@@ -0,0 +1,78 @@
+// Checks that invalid positions in a batch are skipped without losing the valid ones:
+//   batch_test
+// Returns 1 and prints what went wrong on a failure.
+
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "batch.hpp"
+#include "position_record.hpp"
+
+// ---
+#define CHESS_NO_EXCEPTIONS
+#include <chess.hpp>
+// ---
+
+namespace {
+
+bool check(bool condition, std::string const &message) {
+  if (not condition) {
+    std::cout << "FAILED: " << message << std::endl;
+  }
+  return condition;
+}
+
+// An all-zero record has no kings, decoding and searching it used to crash the whole run
+bool zeroRecord(BatchAnalyser &analyser, SearchLimits const &limits) {
+  PositionRecord valid;
+  valid.board = chess::Board::Compact::encode(chess::Board());
+  PositionRecord const zero{};
+
+  std::vector<std::byte> records(3 * sizeof(PositionRecord));
+  std::memcpy(records.data(), &zero, sizeof(PositionRecord));
+  std::memcpy(records.data() + sizeof(PositionRecord), &valid, sizeof(PositionRecord));
+  std::memcpy(records.data() + 2 * sizeof(PositionRecord), &zero, sizeof(PositionRecord));
+
+  std::ostringstream output;
+  auto const positions = analyser.run(records, output, limits);
+  auto const bytes     = output.str();
+
+  bool passed = check(positions == 1, "zero record: " + std::to_string(positions) + " positions");
+  passed = check(bytes.size() == sizeof(PositionRecord), "zero record: one record written") &&
+           passed;
+  if (bytes.size() == sizeof(PositionRecord)) {
+    PositionRecord result;
+    std::memcpy(&result, bytes.data(), sizeof(PositionRecord));
+    passed = check(result.board == valid.board && result.move != 0 && result.depth == 2,
+                   "zero record: valid position analysed") &&
+             passed;
+  }
+  return passed;
+}
+
+bool invalidLines(BatchAnalyser &analyser, SearchLimits const &limits) {
+  std::istringstream input("garbage/line w\n" + std::string(chess::constants::STARTPOS) +
+                           "\n8/8/8/8/8/8/8/8 w - - 0 1\n");
+  std::ostringstream output;
+  auto const positions = analyser.run(input, output, limits);
+  return check(positions == 1, "invalid lines: " + std::to_string(positions) + " positions") &&
+         check(output.str().find(std::string(chess::constants::STARTPOS) + ',') !=
+                   std::string::npos,
+               "invalid lines: valid position analysed");
+}
+
+} // namespace
+
+int main() {
+  BatchAnalyser analyser(1, 2);
+  SearchLimits limits;
+  limits.depth = 2;
+
+  bool passed = zeroRecord(analyser, limits);
+  passed      = invalidLines(analyser, limits) && passed;
+  std::cout << (passed ? "ok" : "FAILED") << std::endl;
+  return passed ? 0 : 1;
+}
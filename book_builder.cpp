@@ -0,0 +1,277 @@
+// Builds a Polyglot opening book from PGN databases:
+//   book_builder [--max-ply N] [--min-games N] [--threads N] <book.bin> <games.pgn>...
+
+// The PGN reader and the SAN parser report malformed games through exceptions, so unlike the
+// engine this tool includes chess.hpp with exceptions enabled, before any other header.
+#include <chess.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <istream>
+#include <span>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "mapped_file.hpp"
+#include "polyglot.hpp"
+#include "thread_pool.hpp"
+
+namespace {
+
+constexpr auto DEFAULT_MAX_PLY   = 16;
+constexpr auto DEFAULT_MIN_GAMES = 1;
+// Every file is split into this many chunks per worker, so uneven chunks still balance out
+constexpr std::size_t CHUNKS_PER_WORKER = 4;
+// Where a game starts, chunks are only split there
+constexpr std::string_view GAME_START = "\n[Event ";
+
+struct BookMove {
+  std::uint64_t key;
+  std::uint16_t move;
+
+  bool operator==(BookMove const &) const = default;
+};
+
+struct BookMoveHash {
+  std::size_t operator()(BookMove const &book_move) const {
+    return book_move.key ^ (std::size_t{book_move.move} * 0x9E3779B97F4A7C15ULL);
+  }
+};
+
+// Half points from the point of view of the side that played the move, and the number of games
+struct MoveStats {
+  std::uint64_t points = 0;
+  std::uint64_t games  = 0;
+};
+
+using BookStats = std::unordered_map<BookMove, MoveStats, BookMoveHash>;
+
+// Reads a mapped buffer as a stream without copying it
+class SpanStreamBuffer : public std::streambuf {
+public:
+  explicit SpanStreamBuffer(std::string_view data) {
+    auto *const begin = const_cast<char *>(data.data());
+    setg(begin, begin, begin + data.size());
+  }
+};
+
+// Replays every game from the start position up to the maximum ply and counts the moves played.
+// Games from other start positions, without a result or with an illegal move stop counting
+// there.
+class BookVisitor : public chess::pgn::Visitor {
+public:
+  BookVisitor(BookStats &stats, int max_ply) : stats_(stats), max_ply_(max_ply) {}
+
+  void startPgn() override {
+    board_ = start_board_;
+    line_.clear();
+    result_  = Result::UNKNOWN;
+    stopped_ = false;
+  }
+
+  void header(std::string_view key, std::string_view value) override {
+    if (key == "FEN" || key == "SetUp" || key == "Variant") {
+      stopped_ = true;
+    } else if (key == "Result") {
+      result_ = value == "1-0"       ? Result::WHITE_WINS
+                : value == "0-1"     ? Result::BLACK_WINS
+                : value == "1/2-1/2" ? Result::DRAW
+                                     : Result::UNKNOWN;
+    }
+  }
+
+  void startMoves() override {
+    if (stopped_ || result_ == Result::UNKNOWN) {
+      skipPgn(true);
+    }
+  }
+
+  void move(std::string_view san, std::string_view) override {
+    if (stopped_ || static_cast<int>(line_.size()) >= max_ply_) {
+      return;
+    }
+    chess::Move move;
+    try {
+      move = chess::uci::parseSan(board_, san, moves_);
+    } catch (chess::uci::SanParseError const &) {
+      stopped_ = true;
+      return;
+    }
+    if (move == chess::Move::NO_MOVE) {
+      stopped_ = true;
+      return;
+    }
+    line_.push_back({board_.hash(), polyglotMove(move)});
+    board_.makeMove(move);
+  }
+
+  void endPgn() override {
+    if (result_ == Result::UNKNOWN) {
+      return;
+    }
+    // White moves at even plies
+    for (std::size_t ply = 0; ply < line_.size(); ++ply) {
+      bool const white = ply % 2 == 0;
+      bool const won   = result_ == (white ? Result::WHITE_WINS : Result::BLACK_WINS);
+      auto &stats      = stats_[line_[ply]];
+      stats.points += won ? 2 : result_ == Result::DRAW ? 1 : 0;
+      ++stats.games;
+    }
+  }
+
+private:
+  enum class Result : std::uint8_t { UNKNOWN, WHITE_WINS, BLACK_WINS, DRAW };
+
+  BookStats &stats_;
+  int max_ply_;
+  chess::Board const start_board_;
+  chess::Board board_;
+  chess::Movelist moves_;
+  std::vector<BookMove> line_;
+  Result result_ = Result::UNKNOWN;
+  bool stopped_  = false;
+};
+
+// Splits the games of a PGN into roughly equal chunks, each starting at the beginning of a game
+std::vector<std::string_view> splitGames(std::string_view pgn, std::size_t count) {
+  std::vector<std::string_view> chunks;
+  std::size_t begin = 0;
+  while (begin < pgn.size()) {
+    auto const target = begin + std::max<std::size_t>(pgn.size() / count, 1);
+    auto end = target < pgn.size() ? pgn.find(GAME_START, target) : std::string_view::npos;
+    end      = end == std::string_view::npos ? pgn.size() : end + 1;
+    chunks.push_back(pgn.substr(begin, end - begin));
+    begin = end;
+  }
+  return chunks;
+}
+
+// Polyglot weights are 16 bits, scale a position's moves down together if they don't fit
+void appendEntries(std::vector<PolyglotEntry> &entries, std::span<PolyglotEntry> position) {
+  std::uint64_t max_weight = 0;
+  for (auto const &entry : position) {
+    max_weight = std::max<std::uint64_t>(max_weight, entry.learn);
+  }
+  for (auto entry : position) {
+    auto const weight = max_weight > UINT16_MAX ? entry.learn * UINT16_MAX / max_weight
+                                                : std::uint64_t{entry.learn};
+    entry.weight = static_cast<std::uint16_t>(weight);
+    entry.learn  = 0;
+    if (entry.weight != 0) {
+      entries.push_back(entry);
+    }
+  }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  int max_ply             = DEFAULT_MAX_PLY;
+  std::uint64_t min_games = DEFAULT_MIN_GAMES;
+  std::size_t num_threads = defaultThreadCount();
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view const arg = argv[i];
+    if (arg == "--max-ply" && i + 1 < argc) {
+      max_ply = std::atoi(argv[++i]);
+    } else if (arg == "--min-games" && i + 1 < argc) {
+      min_games = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--threads" && i + 1 < argc) {
+      num_threads = std::strtoull(argv[++i], nullptr, 10);
+    } else {
+      paths.emplace_back(arg);
+    }
+  }
+  if (paths.size() < 2) {
+    std::cerr << "Usage: book_builder [--max-ply N] [--min-games N] [--threads N] <book.bin> "
+                 "<games.pgn>...\n";
+    return 1;
+  }
+
+  ThreadPool pool(num_threads);
+  std::vector<BookStats> stats(pool.size());
+
+  // The files are mapped, so even databases larger than memory are only paged through
+  for (std::size_t i = 1; i < paths.size(); ++i) {
+    MappedFile const file(paths[i]);
+    if (not file.isOpen()) {
+      std::cerr << "Could not open " << paths[i] << std::endl;
+      return 1;
+    }
+    auto const bytes = file.bytes();
+    std::string_view const pgn(reinterpret_cast<char const *>(bytes.data()), bytes.size());
+    auto const chunks = splitGames(pgn, pool.size() * CHUNKS_PER_WORKER);
+
+    std::atomic<std::size_t> next{0};
+    pool.run(pool.size(), [&](std::size_t const worker) {
+      BookVisitor visitor(stats[worker], max_ply);
+      for (auto index = next++; index < chunks.size(); index = next++) {
+        SpanStreamBuffer buffer(chunks[index]);
+        std::istream stream(&buffer);
+        try {
+          chess::pgn::StreamParser(stream).readGames(visitor);
+        } catch (chess::pgn::StreamParserException const &error) {
+          std::cerr << paths[i] << ": " << error.what() << std::endl;
+        }
+      }
+    });
+  }
+
+  // Merge the workers' counts into the first one
+  auto &merged = stats.front();
+  for (std::size_t i = 1; i < stats.size(); ++i) {
+    for (auto const &[book_move, move_stats] : stats[i]) {
+      auto &total = merged[book_move];
+      total.points += move_stats.points;
+      total.games += move_stats.games;
+    }
+    stats[i] = {};
+  }
+
+  // The raw weight is kept in learn until the position's moves are scaled together
+  std::vector<PolyglotEntry> raw;
+  raw.reserve(merged.size());
+  for (auto const &[book_move, move_stats] : merged) {
+    if (move_stats.games >= min_games) {
+      raw.push_back({book_move.key, book_move.move, 0,
+                     static_cast<std::uint32_t>(std::min<std::uint64_t>(move_stats.points,
+                                                                        UINT32_MAX))});
+    }
+  }
+  merged = {};
+  std::sort(raw.begin(), raw.end(), [](PolyglotEntry const &a, PolyglotEntry const &b) {
+    if (a.key != b.key) {
+      return a.key < b.key;
+    }
+    return a.learn != b.learn ? a.learn > b.learn : a.move < b.move;
+  });
+
+  std::vector<PolyglotEntry> entries;
+  entries.reserve(raw.size());
+  for (auto begin = raw.begin(); begin != raw.end();) {
+    auto const end = std::find_if(begin, raw.end(), [begin](PolyglotEntry const &entry) {
+      return entry.key != begin->key;
+    });
+    appendEntries(entries, std::span(begin, end));
+    begin = end;
+  }
+
+  std::ofstream output(paths.front(), std::ios::binary);
+  for (auto const &entry : entries) {
+    auto const bytes = storePolyglotEntry(entry);
+    output.write(reinterpret_cast<char const *>(bytes.data()), bytes.size());
+  }
+  if (not output) {
+    std::cerr << "Could not write " << paths.front() << std::endl;
+    return 1;
+  }
+  std::cout << "Wrote " << entries.size() << " entries to " << paths.front() << std::endl;
+  return 0;
+}
@@ -1,20 +1,300 @@
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "batch.hpp"
+#include "bench.hpp"
 #include "bot.hpp"
+#include "mapped_file.hpp"
+#include "search_stats.hpp"
+#include "server.hpp"
+#include "uci.hpp"
+
+// Batch input and output are either text or PositionRecord arrays
+int runBatch(BatchAnalyser &analyser, std::string const &path, bool binary_input,
+             bool binary_output, SearchLimits const &limits) {
+  auto const format = binary_output ? BatchAnalyser::Format::RECORDS : BatchAnalyser::Format::CSV;
+#ifdef _WIN32
+  if (binary_input && path == "-") {
+    _setmode(_fileno(stdin), _O_BINARY);
+  }
+  if (binary_output) {
+    _setmode(_fileno(stdout), _O_BINARY);
+  }
+#endif
+
+  if (not binary_input) {
+    if (path == "-") {
+      analyser.run(std::cin, std::cout, limits, format);
+      return 0;
+    }
+    std::ifstream input(path);
+    if (not input) {
+      std::cerr << "Could not open " << path << std::endl;
+      return 1;
+    }
+    analyser.run(input, std::cout, limits, format);
+    return 0;
+  }
+
+  // Files are mapped, a pipe has to be read into memory first
+  if (path == "-") {
+    std::vector<char> const buffer{std::istreambuf_iterator<char>(std::cin),
+                                   std::istreambuf_iterator<char>()};
+    analyser.run(std::as_bytes(std::span(buffer)), std::cout, limits, format);
+    return 0;
+  }
+  MappedFile const file(path);
+  if (not file.isOpen()) {
+    std::cerr << "Could not open " << path << std::endl;
+    return 1;
+  }
+  analyser.run(file.bytes(), std::cout, limits, format);
+  return 0;
+}
+
+// Searches the bench positions with one thread and again with all of them if there are more.
+// Returns 1 if a run of the baseline visited different nodes with one thread, which means the
+// search changed, or was slower by more than the tolerance in percent.
+int runBench(Bot &bot, std::size_t num_threads, int depth, std::string const &baseline_path,
+             std::string const &save_path, double tolerance) {
+  std::vector<BenchResult> baseline;
+  if (not baseline_path.empty()) {
+    std::ifstream input(baseline_path);
+    if (not input) {
+      std::cerr << "Could not open " << baseline_path << std::endl;
+      return 1;
+    }
+    for (std::string line; std::getline(input, line);) {
+      BenchResult result;
+      if (parseBenchLine(line, result)) {
+        baseline.push_back(result);
+      }
+    }
+  }
 
-int main() {
-  Bot bot;
+  std::vector<std::size_t> thread_counts{1};
+  if (num_threads > 1) {
+    thread_counts.push_back(num_threads);
+  }
 
-  std::string input;
-  while (true) {
-    // Read a line of input
-    std::getline(std::cin, input);
+  bool failed = false;
+  std::vector<BenchResult> results;
+  for (auto const threads : thread_counts) {
+    bot.setThreadCount(threads);
+    auto const result = benchmark(bot, depth, [](std::size_t index, Bot::MoveAndEval const &search,
+                                                 std::chrono::microseconds time) {
+      std::cout << "Position " << index + 1 << '/' << BENCH_POSITIONS.size() << ": "
+                << chess::uci::moveToUci(search.move) << ", " << search.nodes << " nodes, "
+                << time.count() / 1000 << " ms" << std::endl;
+    });
+    std::cout << benchLine(result) << " nps " << result.nps() << std::endl;
+    results.push_back(result);
 
-    // Exit condition
-    if (input == "quit") {
-      break;
+    auto const base = std::find_if(baseline.begin(), baseline.end(), [&](BenchResult const &b) {
+      return b.threads == result.threads && b.depth == result.depth;
+    });
+    if (base == baseline.end()) {
+      if (not baseline.empty()) {
+        std::cout << "No baseline for " << threads << " threads at depth " << depth << std::endl;
+      }
+      continue;
+    }
+    auto const change =
+        (static_cast<double>(result.nps()) / static_cast<double>(base->nps()) - 1) * 100;
+    std::cout << "Baseline: " << base->nodes << " nodes, " << base->nps() << " nps, "
+              << std::showpos << change << std::noshowpos << "% nps" << std::endl;
+    // Several threads never search the same nodes twice
+    if (threads == 1 && result.nodes != base->nodes) {
+      std::cout << "Node signature differs from the baseline" << std::endl;
+      failed = true;
+    }
+    if (change < -tolerance) {
+      std::cout << "Slower than the baseline" << std::endl;
+      failed = true;
     }
+  }
 
-    // Echo the input back
-    std::cout << bot.findBestWhiteMoveUci(input) << std::endl;
+  if (not save_path.empty()) {
+    std::ofstream output(save_path);
+    for (auto const &result : results) {
+      output << benchLine(result) << '\n';
+    }
+    if (not output) {
+      std::cerr << "Could not write " << save_path << std::endl;
+      return 1;
+    }
   }
+  return failed ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+  std::size_t hash_mb     = DEFAULT_HASH_MB;
+  std::size_t num_threads = defaultThreadCount();
+  SearchLimits limits;
+  std::string nnue_path;
+  std::string book_path;
+  std::string syzygy_path;
+  // Plain FEN clients get pondering on their time, UCI GUIs control it themselves
+  bool ponder = false;
+  // FEN or EPD file to analyse instead of running the UCI loop, "-" reads standard input
+  std::string batch_path;
+  bool binary_input  = false;
+  bool binary_output = false;
+  // Runs the bench positions instead of the UCI loop, optionally against a baseline
+  bool bench             = false;
+  int bench_depth        = BENCH_DEPTH;
+  double bench_tolerance = BENCH_TOLERANCE;
+  std::string baseline_path;
+  std::string save_baseline_path;
+  // Plays the games of many clients over standard input and output instead of the UCI loop
+  bool server = false;
+  // Deterministic searches, see Bot::setSeed
+  std::optional<std::uint64_t> seed;
+  // Appends the statistics of every search as a line of JSON, "-" writes to standard error
+  std::string stats_path;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view const arg = argv[i];
+    if (arg == "--hash-mb" && i + 1 < argc) {
+      hash_mb = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--threads" && i + 1 < argc) {
+      num_threads = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--depth" && i + 1 < argc) {
+      limits.depth = bench_depth = std::atoi(argv[++i]);
+    } else if (arg == "--movetime" && i + 1 < argc) {
+      limits.movetime = std::chrono::milliseconds(std::strtoll(argv[++i], nullptr, 10));
+    } else if (arg == "--nodes" && i + 1 < argc) {
+      limits.nodes = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--multipv" && i + 1 < argc) {
+      limits.multipv = std::max<std::size_t>(std::strtoull(argv[++i], nullptr, 10), 1);
+    } else if (arg == "--nnue" && i + 1 < argc) {
+      nnue_path = argv[++i];
+    } else if (arg == "--book" && i + 1 < argc) {
+      book_path = argv[++i];
+    } else if (arg == "--syzygy-path" && i + 1 < argc) {
+      syzygy_path = argv[++i];
+    } else if (arg == "--batch" && i + 1 < argc) {
+      batch_path = argv[++i];
+    } else if (arg == "--binary-input") {
+      binary_input = true;
+    } else if (arg == "--binary-output") {
+      binary_output = true;
+    } else if (arg == "--stats" && i + 1 < argc) {
+      stats_path = argv[++i];
+    } else if (arg == "--ponder") {
+      ponder = true;
+    } else if (arg == "--seed" && i + 1 < argc) {
+      seed = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--server") {
+      server = true;
+    } else if (arg == "bench") {
+      bench = true;
+    } else if (arg == "--baseline" && i + 1 < argc) {
+      baseline_path = argv[++i];
+    } else if (arg == "--save-baseline" && i + 1 < argc) {
+      save_baseline_path = argv[++i];
+    } else if (arg == "--tolerance" && i + 1 < argc) {
+      bench_tolerance = std::strtod(argv[++i], nullptr);
+    }
+  }
+
+  // The tablebases are shared by every search of the process
+  if (not syzygy_path.empty() && not initSyzygy(syzygy_path)) {
+    std::cerr << "No tablebases found in " << syzygy_path
+              << (SYZYGY_AVAILABLE ? "" : ", built without CHESS_AI_USE_SYZYGY") << std::endl;
+  }
+
+  // Batch workers search concurrently, so lines are written under a lock
+  std::ofstream stats_file;
+  std::ostream *stats_stream = &std::cerr;
+  std::mutex stats_mutex;
+  std::function<void(SearchStats const &)> log_stats;
+  if (not stats_path.empty()) {
+    if (stats_path != "-") {
+      stats_file.open(stats_path, std::ios::app);
+      stats_stream = &stats_file;
+    }
+    if (*stats_stream) {
+      log_stats = [stats_stream, &stats_mutex](SearchStats const &stats) {
+        std::lock_guard const lock(stats_mutex);
+        *stats_stream << searchStatsJson(stats) << std::endl;
+      };
+    } else {
+      std::cerr << "Could not open " << stats_path << std::endl;
+    }
+  }
+
+  if (bench) {
+    Bot bot(hash_mb, 1);
+    if (not nnue_path.empty() && not bot.loadNetwork(nnue_path)) {
+      std::cerr << "Could not load network " << nnue_path << ", using the handcrafted evaluation"
+                << std::endl;
+    }
+    bot.onSearchEnd(log_stats);
+    return runBench(bot, num_threads, bench_depth, baseline_path, save_baseline_path,
+                    bench_tolerance);
+  }
+
+  if (not batch_path.empty()) {
+    BatchAnalyser analyser(hash_mb, num_threads);
+    analyser.onSearchEnd(log_stats);
+    analyser.setSeed(seed);
+    if (not nnue_path.empty() && not analyser.loadNetwork(nnue_path)) {
+      std::cerr << "Could not load network " << nnue_path << ", using the handcrafted evaluation"
+                << std::endl;
+    }
+    return runBatch(analyser, batch_path, binary_input, binary_output, limits);
+  }
+
+  if (server) {
+    // A seeded search clears the table, which every session is searching
+    if (seed) {
+      std::cerr << "--seed can't be used with --server, its sessions share one table" << std::endl;
+      return 1;
+    }
+    // The engines are set up on first use, failures are only reported for the first one
+    Server games(hash_mb, num_threads, limits);
+    games.setupEngines([&, first = true](Bot &engine) mutable {
+      engine.onSearchEnd(log_stats);
+      if (not nnue_path.empty() && not engine.loadNetwork(nnue_path) && first) {
+        std::cerr << "Could not load network " << nnue_path << ", using the handcrafted evaluation"
+                  << std::endl;
+      }
+      if (not engine.loadBook(book_path) && first) {
+        std::cerr << "Could not open book " << book_path << std::endl;
+      }
+      first = false;
+    });
+    games.loop(std::cin);
+    return 0;
+  }
+
+  Bot bot(hash_mb, num_threads);
+  bot.onSearchEnd(log_stats);
+  bot.setSeed(seed);
+  if (not nnue_path.empty() && not bot.loadNetwork(nnue_path)) {
+    std::cerr << "Could not load network " << nnue_path << ", using the handcrafted evaluation"
+              << std::endl;
+  }
+  if (not bot.loadBook(book_path)) {
+    std::cerr << "Could not open book " << book_path << std::endl;
+  }
+
+  // Speaks UCI, plain FEN lines are still answered with a move for the old clients
+  Uci uci(bot, limits);
+  uci.setLegacyPonder(ponder);
+  uci.loop(std::cin);
   return 0;
 }
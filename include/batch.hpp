@@ -0,0 +1,231 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bot.hpp"
+#include "fen.hpp"
+#include "position_record.hpp"
+#include "thread_pool.hpp"
+
+// ---
+#define CHESS_NO_EXCEPTIONS
+#include <chess.hpp>
+// ---
+
+// The FEN of a FEN or EPD line, an EPD's operations are dropped and missing move counters added.
+// Returns an empty string for blank lines and # comments.
+[[nodiscard]] inline std::string positionFen(std::string const &line) {
+  std::istringstream stream(line);
+  std::vector<std::string> fields;
+  for (std::string field; fields.size() < 6 && stream >> field;) {
+    fields.push_back(field);
+  }
+  if (fields.empty() || fields.front().front() == '#') {
+    return {};
+  }
+
+  auto const is_number = [](std::string const &field) {
+    return field.find_first_not_of("0123456789") == std::string::npos;
+  };
+  if (fields.size() < 6 || not is_number(fields[4]) || not is_number(fields[5])) {
+    fields.resize(std::min<std::size_t>(fields.size(), 4));
+    fields.emplace_back("0");
+    fields.emplace_back("1");
+  }
+
+  std::string fen = fields.front();
+  for (std::size_t i = 1; i < fields.size(); ++i) {
+    fen += ' ' + fields[i];
+  }
+  return fen;
+}
+
+// Centipawns from the point of view of the side to move, mates as #moves
+[[nodiscard]] inline std::string csvScore(int score) {
+  if (std::abs(score) > MATE_BOUND) {
+    auto const moves = (MATE_SCORE - std::abs(score) + 1) / 2;
+    return '#' + std::to_string(score > 0 ? moves : -moves);
+  }
+  return std::to_string(score);
+}
+
+// Analyses a stream of positions, one position per worker at a time instead of all workers on
+// one position. Every worker has its own single-threaded Bot, so searches of different positions
+// don't share anything. Results are written in input order as soon as they are available.
+class BatchAnalyser {
+public:
+  enum class Format : std::uint8_t {
+    CSV,    // "fen,bestmove,score,depth,nodes" rows after a header
+    RECORDS // PositionRecord array
+  };
+
+  // The hash is split evenly over the workers
+  BatchAnalyser(std::size_t hash_mb     = DEFAULT_HASH_MB,
+                std::size_t num_workers = defaultThreadCount())
+      : pool_(num_workers) {
+    for (std::size_t i = 0; i < pool_.size(); ++i) {
+      bots_.push_back(std::make_unique<Bot>(std::max<std::size_t>(hash_mb / pool_.size(), 1), 1));
+    }
+  }
+
+  // Every worker loads its own copy of the network
+  bool loadNetwork(std::string const &path) {
+    for (auto &bot : bots_) {
+      if (not bot->loadNetwork(path)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Makes the result of every position independent of the worker and of the positions before it
+  void setSeed(std::optional<std::uint64_t> seed) {
+    for (auto &bot : bots_) {
+      bot->setSeed(seed);
+    }
+  }
+
+  // Called from the worker threads after every search, must be thread-safe
+  void onSearchEnd(std::function<void(SearchStats const &)> const &callback) {
+    for (auto &bot : bots_) {
+      bot->onSearchEnd(callback);
+    }
+  }
+
+  // Reads FEN or EPD lines until the end of input. Lines that aren't a valid position are skipped
+  // with a warning on standard error. Returns the number of positions.
+  std::size_t run(std::istream &input, std::ostream &output, SearchLimits const &limits,
+                  Format format = Format::CSV) {
+    start(output, format);
+    pool_.run(pool_.size(), [&](std::size_t const worker) {
+      auto &bot = *bots_[worker];
+      std::string fen;
+      while (true) {
+        std::size_t index;
+        {
+          std::lock_guard const lock(input_mutex_);
+          fen.clear();
+          for (std::string line; fen.empty() && std::getline(input, line);) {
+            fen = positionFen(line);
+            if (not fen.empty() && not isValidFen(fen)) {
+              std::cerr << "Skipping invalid position: " << line << std::endl;
+              fen.clear();
+            }
+          }
+          if (fen.empty()) {
+            return;
+          }
+          index = next_index_++;
+        }
+
+        auto const result = bot.findBestMove(fen, limits);
+        write(output, index, format, fen, bot, result);
+      }
+    });
+    return next_index_;
+  }
+
+  // Analyses a PositionRecord array, typically a mapped file. Records that don't hold a valid
+  // position are skipped with a warning on standard error. Returns the number of positions.
+  std::size_t run(std::span<std::byte const> records, std::ostream &output,
+                  SearchLimits const &limits, Format format = Format::RECORDS) {
+    start(output, format);
+    std::atomic<std::size_t> next{0};
+    std::atomic<std::size_t> skipped{0};
+    auto const count = recordCount(records);
+    pool_.run(pool_.size(), [&](std::size_t const worker) {
+      auto &bot = *bots_[worker];
+      for (auto index = next++; index < count; index = next++) {
+        auto const packed = readRecord(records, index).board;
+        std::optional<chess::Board> board;
+        if (isValidPackedBoard(packed)) {
+          board = chess::Board::Compact::decode(packed);
+        }
+        if (not board || not isValidFen(board->getFen())) {
+          {
+            std::lock_guard const lock(input_mutex_);
+            std::cerr << "Skipping invalid record " << index << std::endl;
+          }
+          ++skipped;
+          // Nothing is written for it, later results still come out in order
+          write(output, index, std::string());
+          continue;
+        }
+        bot.setPosition(*board);
+        auto const result = bot.findBestMove(limits);
+        // Only the text output needs the FEN
+        write(output, index, format, format == Format::CSV ? bot.board().getFen() : std::string(),
+              bot, result);
+      }
+    });
+    return count - skipped;
+  }
+
+private:
+  void start(std::ostream &output, Format format) {
+    next_index_   = 0;
+    next_written_ = 0;
+    pending_.clear();
+    if (format == Format::CSV) {
+      output << "fen,bestmove,score,depth,nodes" << std::endl;
+    }
+  }
+
+  void write(std::ostream &output, std::size_t index, Format format, std::string const &fen,
+             Bot const &bot, Bot::MoveAndEval const &result) {
+    bool const has_move = result.move != chess::Move::NO_MOVE;
+    if (format == Format::RECORDS) {
+      PositionRecord record;
+      record.board = chess::Board::Compact::encode(bot.board());
+      record.score = has_move ? result.eval : bot.board().inCheck() ? -MATE_SCORE : 0;
+      record.move  = result.move.move();
+      record.depth = static_cast<std::uint8_t>(result.depth);
+      write(output, index,
+            std::string(reinterpret_cast<char const *>(&record), sizeof(PositionRecord)));
+      return;
+    }
+
+    std::string move  = "0000";
+    std::string score = bot.board().inCheck() ? "#0" : "0";
+    if (has_move) {
+      move  = chess::uci::moveToUci(result.move);
+      score = csvScore(result.eval);
+    }
+    write(output, index,
+          fen + ',' + move + ',' + score + ',' + std::to_string(result.depth) + ',' +
+              std::to_string(result.nodes) + '\n');
+  }
+
+  // Holds a result back until every earlier position has been written
+  void write(std::ostream &output, std::size_t index, std::string data) {
+    std::lock_guard const lock(output_mutex_);
+    pending_.emplace(index, std::move(data));
+    for (auto it = pending_.begin(); it != pending_.end() && it->first == next_written_;
+         it = pending_.erase(it)) {
+      output.write(it->second.data(), static_cast<std::streamsize>(it->second.size()));
+      ++next_written_;
+    }
+    output.flush();
+  }
+
+  ThreadPool pool_;
+  std::vector<std::unique_ptr<Bot>> bots_;
+
+  std::mutex input_mutex_;
+  std::size_t next_index_ = 0;
+
+  std::mutex output_mutex_;
+  std::map<std::size_t, std::string> pending_;
+  std::size_t next_written_ = 0;
+};
@@ -1,19 +1,83 @@
 #pragma once
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <random>
+#include <span>
+#include <string>
+#include <string_view>
 #include <thread>
 
+#include "evaluation.hpp"
+#include "move_picker.hpp"
+#include "nnue.hpp"
+#include "polyglot.hpp"
+#include "search_stats.hpp"
+#include "syzygy.hpp"
+#include "thread_pool.hpp"
+#include "transposition_table.hpp"
+
 // ---
 #define CHESS_NO_EXCEPTIONS
 #include <chess.hpp>
 // ---
 
 constexpr auto MATE_SCORE   = std::numeric_limits<int>::max() / 2;
-constexpr auto NTHREADS     = 32;
 constexpr auto SEARCH_DEPTH = 8;
+constexpr auto MAX_PLY      = 128;
+static_assert(MAX_PLY <= STATS_MAX_DEPTH, "every iteration depth needs its node count");
+// Node interval at which threads publish their node count and check the search limits
+constexpr std::uint64_t NODES_PER_CHECK = 1024;
+// A capture that can't lift the score to alpha even with this much positional gain is skipped
+constexpr auto DELTA_MARGIN = 200;
+// Initial half-width of the root aspiration window and the width beyond which it is dropped
+constexpr auto ASPIRATION_WINDOW    = 50;
+constexpr auto ASPIRATION_MAX       = 1000;
+constexpr auto ASPIRATION_MIN_DEPTH = 4;
+// Scores beyond this are mate scores, which are stored in the TT relative to the node
+constexpr auto MATE_BOUND = MATE_SCORE - MAX_PLY;
+// Null-move pruning starts at this depth and searches the null move this much shallower, plus a
+// ply for every four plies of depth
+constexpr auto NULL_MOVE_MIN_DEPTH = 3;
+constexpr auto NULL_MOVE_REDUCTION = 3;
+// Late move reductions apply to quiet moves after the first few at this depth and beyond
+constexpr auto LMR_MIN_DEPTH = 3;
+constexpr auto LMR_MIN_MOVES = 3;
+// Tablebase results are stored in the TT as if searched this much deeper than the probing node
+constexpr auto TB_DEPTH_BONUS = 6;
+// Bounds the search window, unlike INT_MIN it can be negated
+constexpr auto INFINITE_SCORE = MATE_SCORE + 1;
+
+// Whether a node may lie on the principal variation, i.e. is searched with an open window. The
+// root has its own loop in Bot::searchRoot.
+enum class NodeType : std::uint8_t { PV, NON_PV };
+
+[[nodiscard]] inline constexpr int scoreToTT(int score, int ply) {
+  if (score > MATE_BOUND) {
+    return score + ply;
+  }
+  if (score < -MATE_BOUND) {
+    return score - ply;
+  }
+  return score;
+}
+
+[[nodiscard]] inline constexpr int scoreFromTT(int score, int ply) {
+  if (score > MATE_BOUND) {
+    return score - ply;
+  }
+  if (score < -MATE_BOUND) {
+    return score + ply;
+  }
+  return score;
+}
 
 inline constexpr int pieceValue(chess::Piece const &piece) {
   switch (piece.internal()) {
@@ -42,117 +106,305 @@ inline constexpr int pieceValue(chess::Piece const &piece) {
   }
 }
 
-// MVV_LVA_LUT[attacker][victim]
-constexpr std::array<std::array<int, 7>, 7> MVV_LVA_LUT{{
-    {{15, 25, 35, 45, 55, 0, 0}}, // PAWN
-    {{14, 24, 34, 44, 54, 0, 0}}, // KNIGHT
-    {{13, 23, 33, 43, 53, 0, 0}}, // BISHOP
-    {{12, 22, 32, 42, 52, 0, 0}}, // ROOK
-    {{11, 21, 31, 41, 51, 0, 0}}, // QUEEN
-    {{10, 20, 30, 40, 50, 0, 0}}, // KING
-    {{0, 0, 0, 0, 0, 0, 0}}       // NONE (EMPTY)
-}};
-
 [[nodiscard]] inline int evaluateBoard(chess::Board const &board) {
-  int score = 0;
-  for (chess::Square square(0); square < chess::Square::underlying::NO_SQ; ++square) {
-    auto const piece = board.at(square);
-    score += pieceValue(piece);
-  }
-  return score;
+  return evaluationState(board).value();
 }
 
-[[nodiscard]] inline int moveHeuristic(chess::Move const &move, chess::Board const &board) {
-  // MVV-LVA Most Valuable Victim, Least Valuable Attacker
-  auto const attacker_type = board.at(move.from()).type();
-  auto const victim_type   = board.at(move.to()).type();
-  return MVV_LVA_LUT[attacker_type][victim_type];
-}
-
-inline void orderMoves(chess::Movelist &moves, chess::Board const &board) {
-  std::sort(moves.begin(), moves.end(), [&board](chess::Move const &a, chess::Move const &b) {
-    auto const score_a = moveHeuristic(a, board);
-    auto const score_b = moveHeuristic(b, board);
-    return score_a > score_b;
-  });
-}
+// Late move reduction in plies, indexed by [depth][move number], both capped at 63
+inline auto const LMR_REDUCTIONS = [] {
+  std::array<std::array<int, 64>, 64> table{};
+  for (std::size_t depth = 1; depth < 64; ++depth) {
+    for (std::size_t moves = 1; moves < 64; ++moves) {
+      auto const product =
+          std::log(static_cast<double>(depth)) * std::log(static_cast<double>(moves));
+      table[depth][moves] = static_cast<int>(0.75 + product / 2.25);
+    }
+  }
+  return table;
+}();
 
 struct MoveWithEval {
   chess::Move move;
   int eval;
 };
 
+struct SearchLimits {
+  int depth = SEARCH_DEPTH;              // Maximum iteration depth
+  std::chrono::milliseconds movetime{0}; // Wall-clock budget per move, 0 for none
+  std::uint64_t nodes = 0;               // Node budget summed over all threads, 0 for none
+  std::size_t threads = 0;               // Workers of the bot's pool searching, 0 for all
+  std::size_t multipv = 1;               // Best root moves that get an exact score and a line
+  // Optional flags owned by the caller and set from another thread. Stop ends the search as soon
+  // as possible, while ponder is set the movetime budget is not enforced.
+  std::atomic<bool> const *stop   = nullptr;
+  std::atomic<bool> const *ponder = nullptr;
+};
+
+// Reported by the main thread after every completed iteration, once for every line of a MultiPV
+// search from the best one down
+struct SearchInfo {
+  int depth;
+  int score;           // From the point of view of the side to move
+  std::uint64_t nodes; // Exact with one thread
+  std::chrono::milliseconds time;
+  chess::Movelist pv;
+  std::size_t multipv = 1; // Rank of the line, 1 for the best
+};
+
+// One of the best root moves of a search with its principal variation, which starts with it
+struct RootLine {
+  int eval; // From the point of view of the side to move
+  chess::Movelist pv;
+};
+
+// Positions of game history plus search line a board can hold without reallocating
+constexpr auto BOARD_HISTORY_CAPACITY = 1024;
+
+// Board::prev_states_ can't be reserved directly, growing it once gives it the capacity. Copy
+// assignment from a board with a shorter history keeps that capacity.
+inline void reserveHistory(chess::Board &board, int capacity) {
+  for (int i = 0; i < capacity; ++i) {
+    board.makeNullMove();
+  }
+  for (int i = 0; i < capacity; ++i) {
+    board.unmakeNullMove();
+  }
+}
+
+// Everything a node needs that depends on its ply. Nodes use the entry of their own ply, so
+// nothing is allocated or put on the call stack while searching.
+struct SearchStackEntry {
+  chess::Movelist moves;
+  KillerMoves killers{};
+  // Move made at this ply of the current line, chess::Move::NULL_MOVE for a null move
+  chess::Move move{};
+  // A position can't repeat one from before the last null move
+  int plies_from_null = 0;
+  // Only used if a network is loaded
+  NnueAccumulator accumulator;
+};
+
+// State owned by a single worker of the thread pool, reused across searches
+struct SearchThread {
+  SearchThread() {
+    reserveHistory(board, BOARD_HISTORY_CAPACITY);
+    keys.reserve(BOARD_HISTORY_CAPACITY + MAX_PLY + 1);
+    root_moves.reserve(chess::constants::MAX_MOVES);
+    completed_moves.reserve(chess::constants::MAX_MOVES);
+  }
+
+  chess::Board board;
+  // Hashes of the game's positions up to the root, at root_index, followed by the current line
+  // by ply. Repetition detection only looks at these instead of the board's full states.
+  std::vector<std::uint64_t> keys;
+  std::size_t root_index = 0;
+  // Root moves in search order, with the evaluations of the iteration in progress
+  std::vector<MoveWithEval> root_moves;
+  // Root moves with the evaluation of the last completed iteration, best first
+  std::vector<MoveWithEval> completed_moves;
+  int completed_depth = 0;
+  SearchStats stats;
+
+  ButterflyHistory history{};
+
+  std::array<SearchStackEntry, MAX_PLY + 1> stack;
+  // Scratch list for the quiet pawn moves quiescence search takes its queen promotions from
+  chess::Movelist pawn_moves;
+
+  // Killers only make sense for the previous position, history is kept between searches but
+  // halved so that old statistics fade out.
+  void ageHistory() {
+    for (auto &entry : stack) {
+      entry.killers = {};
+    }
+    for (auto &color : history) {
+      for (auto &from : color) {
+        for (auto &entry : from) {
+          entry /= 2;
+        }
+      }
+    }
+  }
+};
+
 struct Bot {
 
+  explicit Bot(std::size_t hash_mb     = DEFAULT_HASH_MB,
+               std::size_t num_threads = defaultThreadCount())
+      : Bot(std::make_shared<TranspositionTable>(hash_mb), num_threads) {}
+
+  // Bots sharing a table learn from each other's searches. Clearing or resizing it affects all of
+  // them.
+  Bot(std::shared_ptr<TranspositionTable> tt, std::size_t num_threads)
+      : tt_(std::move(tt)), pool_(num_threads), threads_(pool_.size()) {
+    reserveHistory(root_board_, BOARD_HISTORY_CAPACITY);
+    game_keys_.reserve(BOARD_HISTORY_CAPACITY);
+    game_keys_.push_back(root_board_.hash());
+  }
+
   struct MoveAndEval {
     chess::Move move;
-    int eval;
+    int eval;                // From the point of view of the side to move
+    int depth;               // Last completed iteration, 0 for a book or tablebase move
+    std::uint64_t nodes = 0; // Summed over all threads
+    SearchStats stats{};     // Summed over all threads, empty without a search
+    // The best SearchLimits::multipv moves of the last completed iteration, best first, empty
+    // without a search. The move played may be another one with the score of the first.
+    std::vector<RootLine> lines{};
   };
 
-  [[nodiscard]] MoveAndEval findBestWhiteMove(std::string fen) {
-    chess::Board const original_board(fen);
+  // Forgets the current game along with everything the search learned in it
+  void newGame() {
+    tt_->clear();
+    for (auto &thread : threads_) {
+      thread.history = {};
+    }
+    setPosition(chess::constants::STARTPOS);
+  }
+
+  // Sets the game to the position after playing the moves, in UCI notation, from the FEN. If that
+  // continues the current game only the new moves are made, otherwise the game starts over from
+  // the FEN. Either way the board keeps the game history for repetition detection. Returns false
+  // on an illegal move, the game then ends at the position before it.
+  bool setPosition(std::string_view fen, std::span<std::string const> moves = {}) {
+    auto const continues = fen == game_fen_ && moves.size() >= game_moves_.size() &&
+                           std::equal(game_moves_.begin(), game_moves_.end(), moves.begin());
+    if (not continues) {
+      // Setting the FEN keeps the capacity of the board's history
+      root_board_.setFen(fen);
+      game_fen_ = fen;
+      game_moves_.clear();
+      game_keys_.assign(1, root_board_.hash());
+    }
+    for (auto i = game_moves_.size(); i < moves.size(); ++i) {
+      if (not makeMove(moves[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Starts a new game at the board. Its history can't be read, so repetitions are only detected
+  // from this position on.
+  void setPosition(chess::Board const &board) {
+    root_board_ = board;
+    game_fen_.clear();
+    game_moves_.clear();
+    game_keys_.assign(1, root_board_.hash());
+  }
+
+  // Plays a move in UCI notation in the current game, returns false if it is illegal
+  bool makeMove(std::string const &uci) {
+    chess::Movelist legal_moves;
+    chess::movegen::legalmoves(legal_moves, root_board_);
+    auto const move = chess::uci::uciToMove(root_board_, uci);
+    if (std::find(legal_moves.begin(), legal_moves.end(), move) == legal_moves.end()) {
+      return false;
+    }
+    root_board_.makeMove(move);
+    game_moves_.push_back(uci);
+    game_keys_.push_back(root_board_.hash());
+    return true;
+  }
+
+  [[nodiscard]] chess::Board const &board() const { return root_board_; }
+
+  // Starts a new game at the FEN and searches it for whichever side is to move
+  [[nodiscard]] MoveAndEval findBestMove(std::string const &fen, SearchLimits const &limits = {}) {
+    setPosition(fen);
+    return findBestMove(limits);
+  }
+
+  // Searches the current position of the game
+  [[nodiscard]] MoveAndEval findBestMove(SearchLimits const &limits = {}) {
+    auto const &original_board = root_board_;
 
     chess::Movelist moves;
     chess::movegen::legalmoves(moves, original_board);
 
+    // Checkmate or stalemate, scored like the search scores them
     if (moves.empty()) {
-      return {chess::Move::NO_MOVE};
+      return {chess::Move::NO_MOVE, original_board.inCheck() ? -MATE_SCORE : 0, 0};
     }
 
-    // Evaluate once at the root
-    int const root_eval = evaluateBoard(original_board);
+    // Picks among book moves and breaks ties between equally good moves
+    auto generator = moveGenerator();
 
-    std::vector<int> move_evals(moves.size());
-    std::vector<std::thread> threads;
+    // A book move is played without searching
+    if (book_) {
+      auto const book_move = book_->probe(original_board, generator);
+      if (book_move != chess::Move::NO_MOVE) {
+        return {book_move, 0, 0};
+      }
+    }
+    // So is the tablebase move, which keeps the result and makes the most progress towards it
+    if (syzygyPieces() > 0) {
+      Wdl wdl;
+      auto const tb_move = probeRoot(original_board, wdl);
+      if (tb_move != chess::Move::NO_MOVE) {
+        return {tb_move, wdlScore(wdl, 0), 0};
+      }
+    }
 
-    auto evaluate_moves = [&](chess::Board const &original_board, chess::Movelist const &moves,
-                              int const start_index, int const end_index, int root_eval) {
-      auto board = original_board;
-      for (int i = start_index; i < end_index; ++i) {
-        // Incremental evaluation on this move
-        int current_eval = root_eval;
-        // Apply incremental changes for this move
-        applyIncrementalEval(board, moves[i], current_eval);
-        board.makeMove(moves[i]);
-        move_evals[i] = minimax(board, SEARCH_DEPTH - 1, std::numeric_limits<int>::min(),
-                                std::numeric_limits<int>::max(), false, current_eval);
-        board.unmakeMove(moves[i]);
+    // Nothing from earlier searches may change the result
+    if (seed_) {
+      tt_->clear();
+      for (auto &thread : threads_) {
+        thread.history = {};
       }
-    };
+    }
 
-    auto const num_threads      = std::min(NTHREADS, static_cast<int>(moves.size()));
-    auto const moves_per_thread = (moves.size() + num_threads - 1) / num_threads;
-    for (int i = 0; i < num_threads; ++i) {
-      auto const start_index = i * moves_per_thread;
-      auto const end_index =
-          std::min(start_index + moves_per_thread, static_cast<int>(moves.size()));
+    // Evaluate once at the root, the search updates this incrementally
+    auto const root_eval = evaluationState(original_board);
 
-      threads.emplace_back(evaluate_moves, original_board, moves, start_index, end_index,
-                           root_eval);
-    }
+    limits_         = limits;
+    limits_.multipv = std::clamp<std::size_t>(limits.multipv, 1, moves.size());
+    start_time_ = std::chrono::steady_clock::now();
+    tt_->newSearch();
+    nodes_.store(0, std::memory_order_relaxed);
+    stop_.store(false, std::memory_order_relaxed);
+    has_result_.store(false, std::memory_order_relaxed);
+
+    auto const num_threads =
+        limits.threads == 0 ? threads_.size() : std::min(limits.threads, threads_.size());
+    std::span<SearchThread> const active(threads_.data(), num_threads);
 
-    for (auto &thread : threads) {
-      if (thread.joinable()) {
-        thread.join();
+    // Copy assignment reuses the capacity of each worker's move history
+    for (auto &thread : active) {
+      thread.board = original_board;
+      thread.keys  = game_keys_;
+      thread.keys.resize(game_keys_.size() + MAX_PLY + 1);
+      thread.root_index               = game_keys_.size() - 1;
+      thread.stack[0].plies_from_null = static_cast<int>(thread.root_index);
+      thread.root_moves.clear();
+      for (auto const &move : moves) {
+        thread.root_moves.push_back({move, 0});
+      }
+      thread.completed_moves = thread.root_moves;
+      thread.completed_depth = 0;
+      thread.stats           = {};
+      thread.ageHistory();
+      if (network_) {
+        network_->refresh(thread.stack[0].accumulator, original_board);
       }
     }
 
-    // Collect moves and their evaluations
-    struct MoveEval {
-      chess::Move move;
-      int eval;
-    };
-    std::vector<MoveEval> move_eval_list;
-    for (size_t i = 0; i < moves.size(); ++i) {
-      move_eval_list.push_back({moves[static_cast<int>(i)], move_evals[i]});
-    }
+    // Lazy SMP: every worker searches the whole tree and they share results through the
+    // transposition table. The main thread's result is the one that is played.
+    pool_.run(num_threads, [&](std::size_t const index) { iterativeDeepening(index, root_eval); });
 
-    // Sort moves in increasing evaluation order
-    std::sort(move_eval_list.begin(), move_eval_list.end(),
-              [](MoveEval const &a, MoveEval const &b) { return a.eval < b.eval; });
+    auto const &main_thread    = threads_.front();
+    auto const &move_eval_list = main_thread.completed_moves;
+    auto const completed_depth = main_thread.completed_depth;
+
+    SearchStats stats;
+    for (auto const &thread : active) {
+      stats += thread.stats;
+    }
+    stats.time = elapsed();
 
     // Find the maximum evaluation
-    int const max_eval = move_eval_list.back().eval;
+    int const max_eval = move_eval_list.front().eval;
 
     // Collect all moves with the maximum evaluation
     std::vector<chess::Move> max_eval_moves;
@@ -165,7 +417,7 @@ struct Bot {
     // Filter out non-capturing moves if we have capturing moves
     std::vector<chess::Move> aggressive_moves;
     for (auto const &move : max_eval_moves) {
-      if (original_board.at(move.to()) != chess::Piece::NONE) {
+      if (original_board.isCapture(move)) {
         // This move captures a piece
         aggressive_moves.push_back(move);
       }
@@ -179,122 +431,679 @@ struct Bot {
     }
 
     // Pick a move randomly among the candidate moves
-    std::random_device rd;
-    std::mt19937 gen(rd());
     std::uniform_int_distribution<> distribution(0, static_cast<int>(candidate_moves.size()) - 1);
-    chess::Move const selected_move = candidate_moves[distribution(gen)];
+    chess::Move const selected_move = candidate_moves[distribution(generator)];
+
+    std::vector<RootLine> lines;
+    if (completed_depth > 0) {
+      auto &board = threads_.front().board;
+      for (std::size_t i = 0; i < limits_.multipv; ++i) {
+        auto const &line = move_eval_list[i];
+        lines.push_back({line.eval, principalVariation(board, line.move, completed_depth)});
+      }
+    }
+
+    if (on_search_end_) {
+      on_search_end_(stats);
+    }
+    return {selected_move, max_eval, completed_depth, stats.nodes, stats, std::move(lines)};
+  }
+
+  std::string findBestMoveUci(std::string const &fen, SearchLimits const &limits = {}) {
+    return chess::uci::moveToUci(findBestMove(fen, limits).move);
+  }
+
+  std::string findBestMoveUci(SearchLimits const &limits = {}) {
+    return chess::uci::moveToUci(findBestMove(limits).move);
+  }
+
+  void clearHash() { tt_->clear(); }
+
+  // Not thread-safe, must not be called while a search is running. Both clear the table or the
+  // per-thread history respectively.
+  void setHashSize(std::size_t megabytes) { tt_->resize(megabytes); }
+
+  void setThreadCount(std::size_t num_threads) {
+    pool_.resize(num_threads);
+    threads_ = std::vector<SearchThread>(pool_.size());
+  }
 
-    return {selected_move, max_eval};
+  [[nodiscard]] std::size_t threadCount() const { return pool_.size(); }
+
+  // Called from the main search thread after every completed iteration
+  void onIteration(std::function<void(SearchInfo const &)> callback) {
+    on_iteration_ = std::move(callback);
+  }
+
+  // With a seed every search starts from an empty table and history, and the book and the choice
+  // among equally good moves draw from a generator seeded with it and the position. A single
+  // thread then always returns the same move, score and node count for the same game and depth or
+  // node limit. Without a seed, std::nullopt, each search picks at random and keeps the table.
+  // Clearing the table is only safe if no other bot shares it.
+  void setSeed(std::optional<std::uint64_t> seed) { seed_ = seed; }
+
+  // Called from the searching thread with the statistics of every search, not of book or
+  // tablebase moves
+  void onSearchEnd(std::function<void(SearchStats const &)> callback) {
+    on_search_end_ = std::move(callback);
   }
 
-  std::string findBestWhiteMoveUci(std::string fen) {
-    return chess::uci::moveToUci(findBestWhiteMove(fen).move);
+  // Switches to the network evaluation. On failure the current evaluation is kept. Not
+  // thread-safe, must not be called while a search is running.
+  bool loadNetwork(std::string const &path) {
+    auto network = NnueNetwork::load(path);
+    if (not network) {
+      return false;
+    }
+    network_ = std::move(network);
+    return true;
+  }
+
+  // The search probes the tablebases, which are loaded for the whole process by initSyzygy, in
+  // positions with at most this many pieces
+  void setSyzygyProbeLimit(int pieces) { syzygy_probe_limit_ = pieces; }
+
+  // Plays from the Polyglot book while the game is in it. An empty path or a failure to open
+  // the book switches it off. Not thread-safe, must not be called while a search is running.
+  bool loadBook(std::string const &path) {
+    book_ = path.empty() ? nullptr : PolyglotBook::open(path);
+    return path.empty() || book_ != nullptr;
   }
 
 private:
-  // This function applies the incremental evaluation changes without making the move yet.
-  void applyIncrementalEval(chess::Board const &board, chess::Move const &move,
-                            int &current_eval) const {
-    // If capture, remove victim's value
-    auto victim = board.at(move.to());
-    if (victim != chess::Piece::NONE) {
-      current_eval -= pieceValue(victim); // Remove victim from evaluation
-    }
-
-    if (move.typeOf() == chess::Move::ENPASSANT) {
-      if (board.sideToMove() == chess::Color::WHITE) {
-        current_eval -= pieceValue(chess::Piece::BLACKPAWN);
-      } else {
-        current_eval -= pieceValue(chess::Piece::WHITEPAWN);
-      }
-    } else if (move.typeOf() == chess::Move::PROMOTION) {
-      auto const attacker = board.at(move.from());
-      // Remove pawn value
-      current_eval -= pieceValue(attacker);
-      // Add promoted piece value
-      chess::Piece promoted_piece;
-      switch (move.promotionType().internal()) {
-      case chess::PieceType::QUEEN:
-        promoted_piece = board.sideToMove() == chess::Color::WHITE ? chess::Piece::WHITEQUEEN
-                                                                   : chess::Piece::BLACKQUEEN;
-        break;
-      case chess::PieceType::ROOK:
-        promoted_piece = board.sideToMove() == chess::Color::WHITE ? chess::Piece::WHITEROOK
-                                                                   : chess::Piece::BLACKROOK;
+  std::shared_ptr<TranspositionTable> tt_;
+  ThreadPool pool_;
+  std::vector<SearchThread> threads_;
+
+  // The current game: its board, and the FEN and moves it was set up from
+  chess::Board root_board_;
+  std::string game_fen_{chess::constants::STARTPOS};
+  std::vector<std::string> game_moves_;
+  // Hashes of the positions of the game, the current one last
+  std::vector<std::uint64_t> game_keys_;
+  // Replaces the handcrafted evaluation when set
+  std::unique_ptr<NnueNetwork const> network_;
+  std::unique_ptr<PolyglotBook const> book_;
+  int syzygy_probe_limit_ = SYZYGY_DEFAULT_PROBE_LIMIT;
+  std::optional<std::uint64_t> seed_;
+
+  SearchLimits limits_;
+  std::chrono::steady_clock::time_point start_time_;
+  std::atomic<std::uint64_t> nodes_{0};
+  std::atomic<bool> stop_{false};
+  // Set once the main thread has completed its first iteration
+  std::atomic<bool> has_result_{false};
+  std::function<void(SearchInfo const &)> on_iteration_;
+  std::function<void(SearchStats const &)> on_search_end_;
+
+  [[nodiscard]] std::mt19937_64 moveGenerator() const {
+    if (seed_) {
+      return std::mt19937_64(*seed_ ^ root_board_.hash());
+    }
+    std::random_device rd;
+    return std::mt19937_64(std::uint64_t{rd()} << 32 | rd());
+  }
+
+  [[nodiscard]] std::chrono::milliseconds elapsed() const {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() -
+                                                                 start_time_);
+  }
+
+  // Nodes of all threads so far for the main thread to report. nodes_ only has the
+  // NODES_PER_CHECK chunks every thread has counted completely, so the main thread adds the rest
+  // of its own count. Helpers are off by less than a chunk each.
+  [[nodiscard]] std::uint64_t searchedNodes(SearchThread const &main_thread) const {
+    return nodes_.load(std::memory_order_relaxed) + main_thread.stats.nodes % NODES_PER_CHECK;
+  }
+
+  // Called by every thread once per NODES_PER_CHECK nodes. The first iteration always runs to
+  // completion so there is a move to return.
+  void checkLimits() {
+    auto const nodes =
+        nodes_.fetch_add(NODES_PER_CHECK, std::memory_order_relaxed) + NODES_PER_CHECK;
+    // An explicit stop doesn't wait for the first iteration, the caller takes any legal move
+    if (stopRequested()) {
+      stop_.store(true, std::memory_order_relaxed);
+      return;
+    }
+    if (not has_result_.load(std::memory_order_relaxed)) {
+      return;
+    }
+    if ((limits_.nodes != 0 && nodes >= limits_.nodes) || outOfTime(elapsed())) {
+      stop_.store(true, std::memory_order_relaxed);
+    }
+  }
+
+  [[nodiscard]] bool stopRequested() const {
+    return limits_.stop != nullptr && limits_.stop->load(std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] bool outOfTime(std::chrono::milliseconds time) const {
+    bool const pondering =
+        limits_.ponder != nullptr && limits_.ponder->load(std::memory_order_relaxed);
+    return limits_.movetime.count() != 0 && not pondering && time >= limits_.movetime;
+  }
+
+  // Follows the best moves stored in the table, as far as they are legal and don't repeat
+  [[nodiscard]] chess::Movelist principalVariation(chess::Board &board, chess::Move first,
+                                                   int max_length) const {
+    chess::Movelist pv;
+    for (auto move = first; move != chess::Move::NO_MOVE && pv.size() < max_length;) {
+      chess::Movelist legal_moves;
+      chess::movegen::legalmoves(legal_moves, board);
+      if (std::find(legal_moves.begin(), legal_moves.end(), move) == legal_moves.end()) {
         break;
-      case chess::PieceType::BISHOP:
-        promoted_piece = board.sideToMove() == chess::Color::WHITE ? chess::Piece::WHITEBISHOP
-                                                                   : chess::Piece::BLACKBISHOP;
+      }
+      pv.add(move);
+      board.makeMove(move);
+      if (board.isRepetition(1)) {
         break;
-      case chess::PieceType::KNIGHT:
-        promoted_piece = board.sideToMove() == chess::Color::WHITE ? chess::Piece::WHITEKNIGHT
-                                                                   : chess::Piece::BLACKKNIGHT;
+      }
+
+      TTEntry entry;
+      move = tt_->probe(board.hash(), entry) ? entry.move : chess::Move::NO_MOVE;
+    }
+    for (auto i = pv.size(); i > 0; --i) {
+      board.unmakeMove(pv[i - 1]);
+    }
+    return pv;
+  }
+
+  void iterativeDeepening(std::size_t const index, EvalState const &root_eval) {
+    auto &thread           = threads_[index];
+    bool const main_thread = index == 0;
+    // Half of the helpers run one ply ahead of the main thread so the workers diverge and fill
+    // the table with different subtrees. Helpers run until the main thread stops them.
+    auto const first_depth = main_thread ? 1 : 1 + static_cast<int>(index % 2);
+    auto const last_depth  = main_thread ? std::max(limits_.depth, 1) : MAX_PLY - 1;
+
+    for (int depth = first_depth; depth <= last_depth; ++depth) {
+      auto const nodes_before = thread.stats.nodes;
+      // Aspiration windows: expect the scores of the best and the last line to stay close to the
+      // previous iteration's and widen the window whenever one falls outside of it
+      auto const last_line     = limits_.multipv - 1;
+      auto const previous      = thread.completed_moves.front().eval;
+      auto const previous_last = thread.completed_moves[last_line].eval;
+      int delta                = ASPIRATION_WINDOW;
+      int alpha                = -INFINITE_SCORE;
+      int beta                 = INFINITE_SCORE;
+      if (thread.completed_depth >= ASPIRATION_MIN_DEPTH && std::abs(previous) < MATE_BOUND &&
+          std::abs(previous_last) < MATE_BOUND) {
+        alpha = previous_last - delta;
+        beta  = previous + delta;
+      }
+
+      while (true) {
+        auto const score =
+            thread.board.sideToMove() == chess::Color::WHITE
+                ? searchRoot<chess::Color::WHITE>(thread, depth, root_eval, alpha, beta)
+                : searchRoot<chess::Color::BLACK>(thread, depth, root_eval, alpha, beta);
+        if (stop_.load(std::memory_order_relaxed)) {
+          break;
+        }
+        // Sorted by searchRoot, the last line is the lowest score that has to be exact
+        auto const last_score = thread.root_moves[last_line].eval;
+        if (score < beta && last_score > alpha) {
+          break;
+        }
+        delta *= 2;
+        if (delta > ASPIRATION_MAX) {
+          alpha = -INFINITE_SCORE;
+          beta  = INFINITE_SCORE;
+        } else if (score >= beta) {
+          beta = score + delta;
+        } else {
+          alpha = last_score - delta;
+        }
+      }
+      thread.stats.depth_nodes[depth] += thread.stats.nodes - nodes_before;
+
+      // An interrupted iteration has unreliable scores, keep the previous one
+      if (stop_.load(std::memory_order_relaxed)) {
         break;
-      default:
-        promoted_piece = chess::Piece::NONE;
+      }
+      thread.completed_moves = thread.root_moves;
+      thread.completed_depth = depth;
+
+      if (main_thread) {
+        has_result_.store(true, std::memory_order_relaxed);
+        if (on_iteration_) {
+          auto const nodes = searchedNodes(thread);
+          auto const time  = elapsed();
+          for (std::size_t i = 0; i < limits_.multipv; ++i) {
+            auto const &line = thread.completed_moves[i];
+            on_iteration_({depth, line.eval, nodes, time,
+                           principalVariation(thread.board, line.move, depth), i + 1});
+          }
+        }
+        // The next iteration takes longer than all previous ones together, don't start it if it
+        // would most likely be interrupted anyway
+        if (outOfTime(elapsed() * 2) || stopRequested()) {
+          break;
+        }
+      }
+    }
+
+    if (main_thread) {
+      stop_.store(true, std::memory_order_relaxed);
+    }
+  }
+
+  // Searches the root moves to the given depth and returns the best score for the side to move.
+  // The first MultiPV moves get the full window, the others a zero window that is only widened
+  // when they look at least as good as the last of the best moves so far. Moves are kept sorted
+  // by their score as they are searched, so that last one is always at the same index.
+  template <chess::Color::underlying us>
+  [[nodiscard]] int searchRoot(SearchThread &thread, int const depth, EvalState const &root_eval,
+                               int const alpha, int const beta) {
+    constexpr auto them = ~us;
+
+    // The best moves are searched first in the next iteration or re-search. Stable insertion sort,
+    // the list is mostly sorted already and std::stable_sort would allocate a buffer.
+    auto const by_eval = [](MoveWithEval const &a, MoveWithEval const &b) {
+      return a.eval > b.eval;
+    };
+    auto const first = thread.root_moves.begin();
+    auto const sort  = [&](auto const it) {
+      std::rotate(std::upper_bound(first, it, *it, by_eval), it, std::next(it));
+    };
+
+    auto &board          = thread.board;
+    auto const last_line = limits_.multipv - 1;
+    int best_score       = -INFINITE_SCORE;
+    auto it              = first;
+    for (; it != thread.root_moves.end(); ++it) {
+      auto &root_move   = *it;
+      auto current_eval = root_eval;
+      makeMove<us>(thread, board, root_move.move, 0, current_eval);
+
+      auto const searched = static_cast<std::size_t>(it - first);
+      int eval;
+      if (searched <= last_line) {
+        eval = -negamax<NodeType::PV, them>(thread, board, depth - 1, 1, -beta, -alpha,
+                                            current_eval);
+      } else {
+        // Moves tying with the last line so far still get an exact score, since the final choice
+        // is made among all equally good moves. Worse moves fail low and get an upper bound.
+        auto const lower = std::max(alpha, thread.root_moves[last_line].eval - 1);
+        eval = -negamax<NodeType::NON_PV, them>(thread, board, depth - 1, 1, -lower - 1, -lower,
+                                                current_eval);
+        if (eval > lower && eval < beta) {
+          eval = -negamax<NodeType::PV, them>(thread, board, depth - 1, 1, -beta, -lower,
+                                              current_eval);
+        }
+      }
+      board.unmakeMove(root_move.move);
+
+      if (stop_.load(std::memory_order_relaxed)) {
+        return 0;
+      }
+      root_move.eval = eval;
+      best_score     = std::max(best_score, eval);
+      sort(it);
+      // Fail high, the window is widened and the iteration repeated
+      if (best_score >= beta) {
+        ++it;
         break;
       }
+    }
+
+    // Moves not searched after a fail high keep their previous score
+    for (; it != thread.root_moves.end(); ++it) {
+      sort(it);
+    }
+    return best_score;
+  }
+
+  // A quiet move caused a cutoff: make it a killer at this ply and reward it in the history
+  static void updateQuietStats(SearchThread &thread, chess::Board const &board,
+                               chess::Move const &move, int ply, int depth) {
+    auto &killers = thread.stack[ply].killers;
+    if (killers[0] != move) {
+      killers[1] = killers[0];
+      killers[0] = move;
+    }
+
+    auto &history = thread.history[board.sideToMove()];
+    updateHistory(history[move.from().index()][move.to().index()], depth * depth);
+  }
 
-      current_eval += pieceValue(promoted_piece);
+  // Makes a move by us at ply and brings the evaluation state of the child node up to date. The
+  // network accumulators form a stack by ply, so unmaking needs no update.
+  template <chess::Color::underlying us>
+  void makeMove(SearchThread &thread, chess::Board &board, chess::Move const &move, int ply,
+                EvalState &eval) const {
+    auto const delta = moveDelta<us>(board, move);
+    eval.apply(delta);
+    board.makeMove(move);
+    thread.stack[ply].move                = move;
+    thread.stack[ply + 1].plies_from_null = thread.stack[ply].plies_from_null + 1;
+    thread.keys[thread.root_index + ply + 1] = board.hash();
+    if (network_) {
+      ProfileTimer const timer(thread.stats.eval_ns);
+      network_->update(thread.stack[ply].accumulator, thread.stack[ply + 1].accumulator, delta,
+                       board);
     }
-    // If there's no capture or promotion or enpassant, evaluation doesn't change.
   }
 
-  [[nodiscard]] int minimax(chess::Board &board, int depth, int alpha, int beta,
-                            bool maximizing_player, int current_eval) {
-    chess::Movelist movelist;
-    chess::movegen::legalmoves(movelist, board);
+  void makeNullMove(SearchThread &thread, chess::Board &board, int ply) const {
+    board.makeNullMove();
+    thread.stack[ply].move                = chess::Move(chess::Move::NULL_MOVE);
+    thread.stack[ply + 1].plies_from_null = 0;
+    thread.keys[thread.root_index + ply + 1] = board.hash();
+    if (network_) {
+      thread.stack[ply + 1].accumulator = thread.stack[ply].accumulator;
+    }
+  }
 
-    auto const game_over = board.isGameOver(movelist);
-    if (game_over.second != chess::GameResult::NONE) {
-      if (game_over.second == chess::GameResult::LOSE) {
-        return maximizing_player ? -MATE_SCORE - depth : MATE_SCORE + depth;
+  // A repetition of a position in the current line is scored as a draw straight away, repeating a
+  // position from the game before the root takes two earlier occurrences like the rules say. Only
+  // positions since the last capture, pawn move or null move, with the same side to move, can be
+  // the same.
+  [[nodiscard]] static bool isRepetition(SearchThread const &thread, chess::Board const &board,
+                                         int ply) {
+    auto const index = static_cast<int>(thread.root_index) + ply;
+    auto const root  = static_cast<int>(thread.root_index);
+    auto const last  = std::min({static_cast<int>(board.halfMoveClock()),
+                                 thread.stack[ply].plies_from_null, index});
+    auto const key   = thread.keys[index];
+    int count        = 0;
+    for (int back = 4; back <= last; back += 2) {
+      if (thread.keys[index - back] == key && (index - back >= root || ++count == 2)) {
+        return true;
       }
+    }
+    return false;
+  }
+
+  // Static evaluation from the point of view of us, the side to move
+  template <chess::Color::underlying us>
+  [[nodiscard]] int evaluate(SearchThread &thread, EvalState const &eval, int ply) const {
+    ProfileTimer const timer(thread.stats.eval_ns);
+    if (network_) {
+      return network_->evaluate(thread.stack[ply].accumulator, us);
+    }
+    return us == chess::Color::WHITE ? eval.value() : -eval.value();
+  }
+
+  // Scores are from the point of view of us, the side to move. The node type decides at compile
+  // time whether the node may be on the principal variation.
+  template <NodeType node, chess::Color::underlying us>
+  [[nodiscard]] int negamax(SearchThread &thread, chess::Board &board, int depth, int ply,
+                            int alpha, int beta, EvalState const &current_eval) {
+    constexpr bool pv_node = node == NodeType::PV;
+    constexpr auto them    = ~us;
+
+    // Leaves don't need a move list, quiescence generates only the captures it searches.
+    // Reductions can take the depth below zero.
+    if (depth <= 0) {
+      return quiesce<us>(thread, board, ply, alpha, beta, current_eval);
+    }
+
+    if ((++thread.stats.nodes & (NODES_PER_CHECK - 1)) == 0) {
+      checkLimits();
+    }
+    if (stop_.load(std::memory_order_relaxed)) {
       return 0;
     }
 
-    if (depth == 0) {
-      return current_eval;
+    // Draws that can be detected without generating moves
+    if (isInsufficientMaterial(current_eval, board) || isRepetition(thread, board, ply)) {
+      return 0;
     }
 
-    orderMoves(movelist, board);
+    auto const hash       = board.hash();
+    auto const alpha_orig = alpha;
 
-    int best_score;
-    if (maximizing_player) {
-      best_score = std::numeric_limits<int>::min();
-      for (auto const &move : movelist) {
-        int old_eval = current_eval;
-        applyIncrementalEval(board, move, current_eval);
-        board.makeMove(move);
-
-        auto const eval = minimax(board, depth - 1, alpha, beta, false, current_eval);
-
-        board.unmakeMove(move);
-        current_eval = old_eval; // restore evaluation
-
-        best_score = std::max(best_score, eval);
-        alpha      = std::max(alpha, eval);
-        if (beta <= alpha) {
-          break; // Beta cut-off
+    TTEntry entry;
+    chess::Move tt_move = chess::Move::NO_MOVE;
+    ++thread.stats.tt_probes;
+    if (tt_->probe(hash, entry)) {
+      ++thread.stats.tt_hits;
+      tt_move = entry.move;
+      // PV nodes always search, which keeps the principal variation and its score exact
+      if (not pv_node && entry.depth >= depth) {
+        auto const tt_score = scoreFromTT(entry.score, ply);
+        if (entry.bound == Bound::EXACT || (entry.bound == Bound::LOWER && tt_score >= beta) ||
+            (entry.bound == Bound::UPPER && tt_score <= alpha)) {
+          ++thread.stats.tt_cutoffs;
+          return tt_score;
+        }
+      }
+    }
+
+    // Tablebase positions have an exact result, which is only searched further where it leaves
+    // the window open. It stays valid for much deeper searches than the one storing it.
+    Wdl wdl;
+    if (board.occ().count() <= std::min(syzygy_probe_limit_, syzygyPieces()) &&
+        probeWdl(board, wdl)) {
+      ++thread.stats.tb_hits;
+      auto const tb_score = wdlScore(wdl, ply);
+      auto const bound    = wdl == Wdl::WIN    ? Bound::LOWER
+                            : wdl == Wdl::LOSS ? Bound::UPPER
+                                               : Bound::EXACT;
+      if (bound == Bound::EXACT || (bound == Bound::LOWER && tb_score >= beta) ||
+          (bound == Bound::UPPER && tb_score <= alpha)) {
+        tt_->store(hash, std::min(depth + TB_DEPTH_BONUS, MAX_PLY - 1), bound,
+                  scoreToTT(tb_score, ply), chess::Move::NO_MOVE);
+        return tb_score;
+      }
+    }
+
+    auto const in_check = board.inCheck();
+
+    // Fifty-move rule. Only a mate takes precedence, so the moves are needed when in check.
+    if (board.isHalfMoveDraw() && not in_check) {
+      return 0;
+    }
+
+    // Null-move pruning: if the opponent can't reach beta even when we pass, a real move would
+    // fail high as well. Passing is the best move in zugzwang, which is common when only pawns
+    // are left, and two null moves in a row would just search the same position shallower.
+    if constexpr (not pv_node) {
+      if (depth >= NULL_MOVE_MIN_DEPTH && not in_check && std::abs(beta) < MATE_BOUND &&
+          thread.stack[ply - 1].move != chess::Move::NULL_MOVE && board.hasNonPawnMaterial(us)) {
+        auto const static_eval = evaluate<us>(thread, current_eval, ply);
+        if (static_eval >= beta) {
+          auto const reduction =
+              NULL_MOVE_REDUCTION + depth / 4 + std::min((static_eval - beta) / 200, 2);
+          makeNullMove(thread, board, ply);
+          auto const score = -negamax<NodeType::NON_PV, them>(
+              thread, board, depth - 1 - reduction, ply + 1, -beta, -beta + 1, current_eval);
+          board.unmakeNullMove();
+          if (score >= beta) {
+            // A mate found after passing is not proven
+            return score >= MATE_BOUND ? beta : score;
+          }
         }
       }
+    }
+
+    auto &movelist = thread.stack[ply].moves;
+    {
+      ProfileTimer const timer(thread.stats.movegen_ns);
+      chess::movegen::legalmoves(movelist, board);
+    }
+
+    if (movelist.empty()) {
+      if (in_check) {
+        return -MATE_SCORE + ply;
+      }
+      return 0; // Stalemate
+    }
+    // In check but not mated
+    if (board.isHalfMoveDraw()) {
+      return 0;
+    }
+
+    MovePicker picker(movelist, board, tt_move, &thread.stack[ply].killers, &thread.history);
+
+    int best_score        = -INFINITE_SCORE;
+    chess::Move best_move = chess::Move::NO_MOVE;
+    int move_count        = 0;
+    for (chess::Move move; (move = picker.next()) != chess::Move::NO_MOVE;) {
+      ++move_count;
+      bool const quiet = isQuiet(board, move);
+      auto new_eval    = current_eval;
+      makeMove<us>(thread, board, move, ply, new_eval);
+
+      // Principal variation search: after the first move, prove with a zero window that a move is
+      // no better than alpha and only re-search it with the full window if that fails
+      int eval;
+      if (move_count == 1) {
+        eval = -negamax<node, them>(thread, board, depth - 1, ply + 1, -beta, -alpha, new_eval);
+      } else {
+        // Late move reductions: quiet moves ordered late rarely matter, search them shallower
+        // first and at full depth only if they turn out to beat alpha
+        int reduction = 0;
+        if (depth >= LMR_MIN_DEPTH && move_count > LMR_MIN_MOVES && quiet && not in_check &&
+            not board.inCheck()) {
+          reduction = LMR_REDUCTIONS[std::min(depth, 63)][std::min(move_count, 63)];
+          if constexpr (pv_node) {
+            --reduction;
+          }
+          if (picker.stage() == MovePicker::Stage::KILLERS) {
+            --reduction;
+          }
+          reduction = std::clamp(reduction, 0, depth - 2);
+        }
+
+        eval = -negamax<NodeType::NON_PV, them>(thread, board, depth - 1 - reduction, ply + 1,
+                                                -alpha - 1, -alpha, new_eval);
+        if (reduction > 0 && eval > alpha) {
+          eval = -negamax<NodeType::NON_PV, them>(thread, board, depth - 1, ply + 1, -alpha - 1,
+                                                  -alpha, new_eval);
+        }
+        if (pv_node && eval > alpha && eval < beta) {
+          eval = -negamax<NodeType::PV, them>(thread, board, depth - 1, ply + 1, -beta, -alpha,
+                                              new_eval);
+        }
+      }
+
+      board.unmakeMove(move);
+
+      if (eval > best_score) {
+        best_score = eval;
+        best_move  = move;
+      }
+      alpha = std::max(alpha, eval);
+      if (alpha >= beta) {
+        ++thread.stats.cutoffs;
+        thread.stats.first_move_cutoffs += move_count == 1;
+        if (quiet) {
+          updateQuietStats(thread, board, move, ply, depth);
+        }
+        break; // Beta cut-off
+      }
+    }
+
+    // Scores of an interrupted search must not end up in the table
+    if (stop_.load(std::memory_order_relaxed)) {
+      return 0;
+    }
+
+    // The bounds are relative to the window this node was called with
+    auto bound = Bound::EXACT;
+    if (best_score <= alpha_orig) {
+      bound = Bound::UPPER;
+    } else if (best_score >= beta) {
+      bound = Bound::LOWER;
+    }
+    tt_->store(hash, depth, bound, scoreToTT(best_score, ply), best_move);
+
+    return best_score;
+  }
+
+  // Resolves captures and promotions at the horizon so positions are only evaluated once they are
+  // quiet. When in check every evasion is searched instead, which also detects mate.
+  template <chess::Color::underlying us>
+  [[nodiscard]] int quiesce(SearchThread &thread, chess::Board &board, int ply, int alpha,
+                            int beta, EvalState const &current_eval) {
+    constexpr auto them = ~us;
+
+    ++thread.stats.qnodes;
+    if ((++thread.stats.nodes & (NODES_PER_CHECK - 1)) == 0) {
+      checkLimits();
+    }
+    if (stop_.load(std::memory_order_relaxed)) {
+      return 0;
+    }
+
+    auto const in_check  = board.inCheck();
+    auto const stand_pat = evaluate<us>(thread, current_eval, ply);
+    if (ply >= MAX_PLY - 1) {
+      return stand_pat;
+    }
+
+    auto &movelist = thread.stack[ply].moves;
+    int best_score;
+    if (in_check) {
+      {
+        ProfileTimer const timer(thread.stats.movegen_ns);
+        chess::movegen::legalmoves(movelist, board);
+      }
+      if (movelist.empty()) {
+        return -MATE_SCORE + ply;
+      }
+      best_score = -INFINITE_SCORE;
     } else {
-      best_score = std::numeric_limits<int>::max();
-      for (auto const &move : movelist) {
-        int old_eval = current_eval;
-        applyIncrementalEval(board, move, current_eval);
-        board.makeMove(move);
+      // Stand pat: the side to move can usually do at least as well as the static evaluation
+      best_score = stand_pat;
+      if (best_score >= beta) {
+        return best_score;
+      }
+      alpha = std::max(alpha, best_score);
 
-        auto const eval = minimax(board, depth - 1, alpha, beta, true, current_eval);
+      {
+        ProfileTimer const timer(thread.stats.movegen_ns);
+        chess::movegen::legalmoves<chess::movegen::MoveGenType::CAPTURE>(movelist, board);
+        // Capture generation skips quiet promotions, add the queen ones
+        if (board.pieces(chess::PieceType::PAWN, us) &
+            chess::Rank::rank(chess::Rank::RANK_7, us).bb()) {
+          auto &quiets = thread.pawn_moves;
+          chess::movegen::legalmoves<chess::movegen::MoveGenType::QUIET>(
+              quiets, board, chess::PieceGenType::PAWN);
+          for (auto const &move : quiets) {
+            if (move.typeOf() == chess::Move::PROMOTION &&
+                move.promotionType() == chess::PieceType::QUEEN) {
+              movelist.add(move);
+            }
+          }
+        }
+      }
+    }
 
-        board.unmakeMove(move);
-        current_eval = old_eval; // restore evaluation
+    MovePicker picker(movelist, board);
 
-        best_score = std::min(best_score, eval);
-        beta       = std::min(beta, eval);
-        if (beta <= alpha) {
-          break; // Alpha cut-off
+    for (chess::Move move; (move = picker.next()) != chess::Move::NO_MOVE;) {
+      if (not in_check) {
+        // Captures that lose material are not worth resolving
+        if (picker.stage() == MovePicker::Stage::BAD_CAPTURES) {
+          break;
+        }
+        // Delta pruning: skip captures that can't bring the score back into the window
+        auto gain = std::abs(pieceValue(board.at(move.to())));
+        if (move.typeOf() == chess::Move::ENPASSANT) {
+          gain = pieceValue(chess::Piece::WHITEPAWN);
+        } else if (move.typeOf() == chess::Move::PROMOTION) {
+          gain += pieceValue(chess::Piece::WHITEQUEEN) - pieceValue(chess::Piece::WHITEPAWN);
         }
+        if (stand_pat + gain + DELTA_MARGIN <= alpha) {
+          continue;
+        }
+      }
+
+      auto new_eval = current_eval;
+      makeMove<us>(thread, board, move, ply, new_eval);
+
+      auto const eval = -quiesce<them>(thread, board, ply + 1, -beta, -alpha, new_eval);
+
+      board.unmakeMove(move);
+
+      best_score = std::max(best_score, eval);
+      alpha      = std::max(alpha, eval);
+      if (alpha >= beta) {
+        break;
       }
     }
 
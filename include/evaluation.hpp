@@ -0,0 +1,315 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+// ---
+#define CHESS_NO_EXCEPTIONS
+#include <chess.hpp>
+// ---
+
+// Tapered evaluation with the PeSTO material values and piece-square tables. Every piece has a
+// middlegame and an endgame score, blended by the game phase: the non-pawn material left on the
+// board. All scores are from white's point of view.
+
+constexpr int PHASE_MAX = 24;
+
+// Indexed by chess::PieceType
+constexpr std::array<int, 6> PHASE_WEIGHTS{0, 1, 1, 2, 4, 0};
+constexpr std::array<int, 6> MG_VALUES{82, 337, 365, 477, 1025, 0};
+constexpr std::array<int, 6> EG_VALUES{94, 281, 297, 512, 936, 0};
+
+using PieceSquareTable = std::array<int, 64>;
+
+// Tables are laid out as seen from white, rank 8 first, and indexed by chess::PieceType
+constexpr std::array<PieceSquareTable, 6> MG_TABLES{{
+    // PAWN
+    {0,   0,   0,   0,   0,   0,   0,  0,   //
+     98,  134, 61,  95,  68,  126, 34, -11, //
+     -6,  7,   26,  31,  65,  56,  25, -20, //
+     -14, 13,  6,   21,  23,  12,  17, -23, //
+     -27, -2,  -5,  12,  17,  6,   10, -25, //
+     -26, -4,  -4,  -10, 3,   3,   33, -12, //
+     -35, -1,  -20, -23, -15, 24,  38, -22, //
+     0,   0,   0,   0,   0,   0,   0,  0},
+    // KNIGHT
+    {-167, -89, -34, -49, 61,  -97, -15, -107, //
+     -73,  -41, 72,  36,  23,  62,  7,   -17,  //
+     -47,  60,  37,  65,  84,  129, 73,  44,   //
+     -9,   17,  19,  53,  37,  69,  18,  22,   //
+     -13,  4,   16,  13,  28,  19,  21,  -8,   //
+     -23,  -9,  12,  10,  19,  17,  25,  -16,  //
+     -29,  -53, -12, -3,  -1,  18,  -14, -19,  //
+     -105, -21, -58, -33, -17, -28, -19, -23},
+    // BISHOP
+    {-29, 4,  -82, -37, -25, -42, 7,   -8,  //
+     -26, 16, -18, -13, 30,  59,  18,  -47, //
+     -16, 37, 43,  40,  35,  50,  37,  -2,  //
+     -4,  5,  19,  50,  37,  37,  7,   -2,  //
+     -6,  13, 13,  26,  34,  12,  10,  4,   //
+     0,   15, 15,  15,  14,  27,  18,  10,  //
+     4,   15, 16,  0,   7,   21,  33,  1,   //
+     -33, -3, -14, -21, -13, -12, -39, -21},
+    // ROOK
+    {32,  42,  32,  51,  63, 9,  31,  43,  //
+     27,  32,  58,  62,  80, 67, 26,  44,  //
+     -5,  19,  26,  36,  17, 45, 61,  16,  //
+     -24, -11, 7,   26,  24, 35, -8,  -20, //
+     -36, -26, -12, -1,  9,  -7, 6,   -23, //
+     -45, -25, -16, -17, 3,  0,  -5,  -33, //
+     -44, -16, -20, -9,  -1, 11, -6,  -71, //
+     -19, -13, 1,   17,  16, 7,  -37, -26},
+    // QUEEN
+    {-28, 0,   29,  12,  59,  44,  43,  45,  //
+     -24, -39, -5,  1,   -16, 57,  28,  54,  //
+     -13, -17, 7,   8,   29,  56,  47,  57,  //
+     -27, -27, -16, -16, -1,  17,  -2,  1,   //
+     -9,  -26, -9,  -10, -2,  -4,  3,   -3,  //
+     -14, 2,   -11, -2,  -5,  2,   14,  5,   //
+     -35, -8,  11,  2,   8,   15,  -3,  1,   //
+     -1,  -18, -9,  10,  -15, -25, -31, -50},
+    // KING
+    {-65, 23,  16,  -15, -56, -34, 2,   13,  //
+     29,  -1,  -20, -7,  -8,  -4,  -38, -29, //
+     -9,  24,  2,   -16, -20, 6,   22,  -22, //
+     -17, -20, -12, -27, -30, -25, -14, -36, //
+     -49, -1,  -27, -39, -46, -44, -33, -51, //
+     -14, -14, -22, -46, -44, -30, -15, -27, //
+     1,   7,   -8,  -64, -43, -16, 9,   8,   //
+     -15, 36,  12,  -54, 8,   -28, 24,  14},
+}};
+
+constexpr std::array<PieceSquareTable, 6> EG_TABLES{{
+    // PAWN
+    {0,   0,   0,   0,   0,   0,   0,   0,   //
+     178, 173, 158, 134, 147, 132, 165, 187, //
+     94,  100, 85,  67,  56,  53,  82,  84,  //
+     32,  24,  13,  5,   -2,  4,   17,  17,  //
+     13,  9,   -3,  -7,  -7,  -8,  3,   -1,  //
+     4,   7,   -6,  1,   0,   -5,  -1,  -8,  //
+     13,  8,   8,   10,  13,  0,   2,   -7,  //
+     0,   0,   0,   0,   0,   0,   0,   0},
+    // KNIGHT
+    {-58, -38, -13, -28, -31, -27, -63, -99, //
+     -25, -8,  -25, -2,  -9,  -25, -24, -52, //
+     -24, -20, 10,  9,   -1,  -9,  -19, -41, //
+     -17, 3,   22,  22,  22,  11,  8,   -18, //
+     -18, -6,  16,  25,  16,  17,  4,   -18, //
+     -23, -3,  -1,  15,  10,  -3,  -20, -22, //
+     -42, -20, -10, -5,  -2,  -20, -23, -44, //
+     -29, -51, -23, -15, -22, -18, -50, -64},
+    // BISHOP
+    {-14, -21, -11, -8, -7, -9,  -17, -24, //
+     -8,  -4,  7,   -12, -3, -13, -4,  -14, //
+     2,   -8,  0,   -1, -2, 6,   0,   4,   //
+     -3,  9,   12,  9,  14, 10,  3,   2,   //
+     -6,  3,   13,  19, 7,  10,  -3,  -9,  //
+     -12, -3,  8,   10, 13, 3,   -7,  -15, //
+     -14, -18, -7,  -1, 4,  -9,  -15, -27, //
+     -23, -9,  -23, -5, -9, -16, -5,  -17},
+    // ROOK
+    {13, 10, 18, 15, 12, 12,  8,   5,   //
+     11, 13, 13, 11, -3, 3,   8,   3,   //
+     7,  7,  7,  5,  4,  -3,  -5,  -3,  //
+     4,  3,  13, 1,  2,  1,   -1,  2,   //
+     3,  5,  8,  4,  -5, -6,  -8,  -11, //
+     -4, 0,  -5, -1, -7, -12, -8,  -16, //
+     -6, -6, 0,  2,  -9, -9,  -11, -3,  //
+     -9, 2,  3,  -1, -5, -13, 4,   -20},
+    // QUEEN
+    {-9,  22,  22,  27,  27,  19,  10,  20,  //
+     -17, 20,  32,  41,  58,  25,  30,  0,   //
+     -20, 6,   9,   49,  47,  35,  19,  9,   //
+     3,   22,  24,  45,  57,  40,  57,  36,  //
+     -18, 28,  19,  47,  31,  34,  39,  23,  //
+     -16, -27, 15,  6,   9,   17,  10,  5,   //
+     -22, -23, -30, -16, -16, -23, -36, -32, //
+     -33, -28, -22, -43, -5,  -32, -20, -41},
+    // KING
+    {-74, -35, -18, -18, -11, 15,  4,   -17, //
+     -12, 17,  14,  17,  17,  38,  23,  11,  //
+     10,  17,  23,  15,  20,  45,  44,  13,  //
+     -8,  22,  24,  27,  26,  33,  26,  3,   //
+     -18, -4,  21,  24,  27,  23,  9,   -11, //
+     -19, -3,  11,  21,  23,  16,  7,   -9,  //
+     -27, -11, 4,   13,  14,  4,   -5,  -17, //
+     -53, -34, -21, -11, -28, -14, -24, -43},
+}};
+
+// Material plus table value of every chess::Piece on every chess::Square, negated for black
+using PieceSquareValues = std::array<std::array<int, 64>, 12>;
+
+[[nodiscard]] inline constexpr PieceSquareValues
+makePieceSquareValues(std::array<int, 6> const &values,
+                      std::array<PieceSquareTable, 6> const &tables) {
+  PieceSquareValues result{};
+  for (int type = 0; type < 6; ++type) {
+    for (int square = 0; square < 64; ++square) {
+      // The tables start at a8 while chess::Square starts at a1, flipping the rank fixes white
+      result[type][square]     = values[type] + tables[type][square ^ 56];
+      result[type + 6][square] = -(values[type] + tables[type][square]);
+    }
+  }
+  return result;
+}
+
+constexpr auto MG_PIECE_SQUARE = makePieceSquareValues(MG_VALUES, MG_TABLES);
+constexpr auto EG_PIECE_SQUARE = makePieceSquareValues(EG_VALUES, EG_TABLES);
+
+// The pieces a move takes off the board and puts on it, the moving piece first. Every evaluation
+// backend updates its state from this instead of decoding the move itself.
+struct MoveDelta {
+  struct Entry {
+    chess::Piece piece;
+    chess::Square square;
+  };
+
+  std::array<Entry, 2> removed;
+  std::array<Entry, 2> added;
+  int num_removed = 0;
+  int num_added   = 0;
+
+  void remove(chess::Piece piece, chess::Square square) {
+    removed[num_removed++] = {piece, square};
+  }
+  void add(chess::Piece piece, chess::Square square) { added[num_added++] = {piece, square}; }
+};
+
+// Must be called before the move by us is made on the board
+template <chess::Color::underlying us>
+[[nodiscard]] inline MoveDelta moveDelta(chess::Board const &board, chess::Move const &move) {
+  constexpr auto them = ~us;
+
+  auto const from  = move.from();
+  auto const to    = move.to();
+  auto const piece = board.at(from);
+
+  MoveDelta delta;
+  // Castling is encoded as the king capturing its own rook
+  if (move.typeOf() == chess::Move::CASTLING) {
+    bool const king_side = to > from;
+    auto const rook      = board.at(to);
+    delta.remove(piece, from);
+    delta.remove(rook, to);
+    delta.add(piece, chess::Square::castling_king_square(king_side, us));
+    delta.add(rook, chess::Square::castling_rook_square(king_side, us));
+    return delta;
+  }
+
+  delta.remove(piece, from);
+  if (move.typeOf() == chess::Move::ENPASSANT) {
+    delta.remove(chess::Piece(chess::PieceType::PAWN, them), to.ep_square());
+  } else if (auto const victim = board.at(to); victim != chess::Piece::NONE) {
+    delta.remove(victim, to);
+  }
+  if (move.typeOf() == chess::Move::PROMOTION) {
+    delta.add(chess::Piece(move.promotionType(), us), to);
+  } else {
+    delta.add(piece, to);
+  }
+  return delta;
+}
+
+// Squares of the same color as h1
+constexpr std::uint64_t LIGHT_SQUARES = 0x55AA55AA55AA55AAULL;
+
+// Material signature: the number of pieces of each kind, four bits each, indexed by chess::Piece
+[[nodiscard]] inline constexpr std::uint64_t materialKey(chess::Piece::underlying piece,
+                                                         int count = 1) {
+  return static_cast<std::uint64_t>(count) << (4 * static_cast<int>(piece));
+}
+
+// Middlegame and endgame sums of a position. The search keeps one per node and updates it with
+// every move instead of rescanning the board.
+struct EvalState {
+  int mg                 = 0;
+  int eg                 = 0;
+  int phase              = 0;
+  std::uint64_t material = 0;
+
+  void add(chess::Piece piece, chess::Square square) {
+    mg += MG_PIECE_SQUARE[piece][square.index()];
+    eg += EG_PIECE_SQUARE[piece][square.index()];
+    phase += PHASE_WEIGHTS[piece.type()];
+    material += materialKey(piece.internal());
+  }
+
+  void remove(chess::Piece piece, chess::Square square) {
+    mg -= MG_PIECE_SQUARE[piece][square.index()];
+    eg -= EG_PIECE_SQUARE[piece][square.index()];
+    phase -= PHASE_WEIGHTS[piece.type()];
+    material -= materialKey(piece.internal());
+  }
+
+  // Undoing a move is free since every node works on its own copy
+  void apply(MoveDelta const &delta) {
+    for (int i = 0; i < delta.num_removed; ++i) {
+      remove(delta.removed[i].piece, delta.removed[i].square);
+    }
+    for (int i = 0; i < delta.num_added; ++i) {
+      add(delta.added[i].piece, delta.added[i].square);
+    }
+  }
+
+  // Blends the middlegame and endgame scores by the remaining material
+  [[nodiscard]] int value() const {
+    auto const mg_phase = std::min(phase, PHASE_MAX);
+    return (mg * mg_phase + eg * (PHASE_MAX - mg_phase)) / PHASE_MAX;
+  }
+};
+
+// Computes the state from scratch, material by popcount and the tables bit by bit
+[[nodiscard]] inline EvalState evaluationState(chess::Board const &board) {
+  EvalState state;
+  for (int type = 0; type < 6; ++type) {
+    auto const piece_type = chess::PieceType(static_cast<chess::PieceType::underlying>(type));
+    auto const white      = board.pieces(piece_type, chess::Color::WHITE);
+    auto const black      = board.pieces(piece_type, chess::Color::BLACK);
+    auto const balance    = white.count() - black.count();
+
+    state.mg += balance * MG_VALUES[type];
+    state.eg += balance * EG_VALUES[type];
+    state.phase += (white.count() + black.count()) * PHASE_WEIGHTS[type];
+    state.material += materialKey(chess::Piece(piece_type, chess::Color::WHITE).internal(),
+                                  white.count()) +
+                      materialKey(chess::Piece(piece_type, chess::Color::BLACK).internal(),
+                                  black.count());
+
+    for (auto bb = white; bb;) {
+      auto const square = bb.pop();
+      state.mg += MG_TABLES[type][square ^ 56];
+      state.eg += EG_TABLES[type][square ^ 56];
+    }
+    for (auto bb = black; bb;) {
+      auto const square = bb.pop();
+      state.mg -= MG_TABLES[type][square];
+      state.eg -= EG_TABLES[type][square];
+    }
+  }
+  return state;
+}
+
+// Neither side can mate: bare kings, a single minor piece, or only bishops on squares of one
+// color. The board is only looked at for the bishop squares.
+[[nodiscard]] inline bool isInsufficientMaterial(EvalState const &eval,
+                                                 chess::Board const &board) {
+  using chess::Piece;
+  constexpr auto KINGS = materialKey(Piece::WHITEKING) + materialKey(Piece::BLACKKING);
+  switch (eval.material - KINGS) {
+  case 0:
+  case materialKey(Piece::WHITEKNIGHT):
+  case materialKey(Piece::BLACKKNIGHT):
+  case materialKey(Piece::WHITEBISHOP):
+  case materialKey(Piece::BLACKBISHOP):
+    return true;
+  case materialKey(Piece::WHITEBISHOP) + materialKey(Piece::BLACKBISHOP):
+  case materialKey(Piece::WHITEBISHOP, 2):
+  case materialKey(Piece::BLACKBISHOP, 2): {
+    auto const bishops = board.pieces(chess::PieceType::BISHOP);
+    return not(bishops & chess::Bitboard(LIGHT_SQUARES)) ||
+           not(bishops & chess::Bitboard(~LIGHT_SQUARES));
+  }
+  default:
+    return false;
+  }
+}
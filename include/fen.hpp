@@ -0,0 +1,112 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// ---
+#define CHESS_NO_EXCEPTIONS
+#include <chess.hpp>
+// ---
+
+// Whether a FEN from a client describes a position the board and the search can take. Without
+// exceptions chess::Board asserts or reads out of bounds on malformed input, so every FEN that
+// doesn't come from the engine itself has to pass this first. Accepts the placement and side to
+// move followed by up to four of the other fields, the board fills in the missing ones. Requires
+// one king per side, no pawns on the first or last rank, castling rights that match the kings
+// and rooks, and the side that just moved not to be in check.
+[[nodiscard]] inline bool isValidFen(std::string_view fen) {
+  std::istringstream stream{std::string(fen)};
+  std::vector<std::string> fields;
+  for (std::string field; stream >> field;) {
+    fields.push_back(field);
+  }
+  if (fields.size() < 2 || fields.size() > 6) {
+    return false;
+  }
+
+  // Piece placement, rank 8 first. Pieces are by square index from a1 up.
+  std::array<char, 64> squares{};
+  int rank     = 7;
+  int file     = 0;
+  int kings[2] = {0, 0};
+  for (char const c : fields[0]) {
+    if (c == '/') {
+      if (file != 8 || rank == 0) {
+        return false;
+      }
+      --rank;
+      file = 0;
+    } else if (c >= '1' && c <= '8') {
+      file += c - '0';
+      if (file > 8) {
+        return false;
+      }
+    } else if (std::string_view("PNBRQKpnbrqk").find(c) != std::string_view::npos) {
+      if (file == 8) {
+        return false;
+      }
+      if ((c == 'P' || c == 'p') && (rank == 0 || rank == 7)) {
+        return false;
+      }
+      if (c == 'K' || c == 'k') {
+        ++kings[c == 'k'];
+      }
+      squares[rank * 8 + file++] = c;
+    } else {
+      return false;
+    }
+  }
+  if (rank != 0 || file != 8 || kings[0] != 1 || kings[1] != 1) {
+    return false;
+  }
+
+  if (fields[1] != "w" && fields[1] != "b") {
+    return false;
+  }
+
+  // Standard chess only, every right needs its king and rook on their starting squares
+  if (fields.size() > 2 && fields[2] != "-") {
+    for (char const c : fields[2]) {
+      bool const white = c == 'K' || c == 'Q';
+      bool const king  = c == 'K' || c == 'k';
+      if (std::string_view("KQkq").find(c) == std::string_view::npos) {
+        return false;
+      }
+      auto const base = white ? 0 : 56;
+      if (squares[base + 4] != (white ? 'K' : 'k') ||
+          squares[base + (king ? 7 : 0)] != (white ? 'R' : 'r')) {
+        return false;
+      }
+    }
+  }
+
+  if (fields.size() > 3 && fields[3] != "-") {
+    auto const &ep = fields[3];
+    if (ep.size() != 2 || ep[0] < 'a' || ep[0] > 'h' || (ep[1] != '3' && ep[1] != '6')) {
+      return false;
+    }
+  }
+
+  // Move counters, short enough that parsing them can't overflow
+  for (std::size_t i = 4; i < fields.size(); ++i) {
+    auto const &counter = fields[i];
+    if (counter.empty() || counter.size() > 6 ||
+        not std::all_of(counter.begin(), counter.end(),
+                        [](unsigned char c) { return std::isdigit(c) != 0; })) {
+      return false;
+    }
+  }
+
+  // The board only splits fields on single spaces
+  std::string normalized = fields[0];
+  for (std::size_t i = 1; i < fields.size(); ++i) {
+    normalized += ' ' + fields[i];
+  }
+  chess::Board const board(normalized);
+  auto const moved = ~board.sideToMove();
+  return not board.isAttacked(board.kingSq(moved), board.sideToMove());
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstddef>
+#include <span>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only memory mapping of a whole file. The file is paged in on demand, so opening even a
+// large file is cheap and its pages are shared between processes mapping the same file.
+class MappedFile {
+public:
+  MappedFile() = default;
+
+  // Check isOpen() for failure, an empty file maps to nothing and is not open either
+  explicit MappedFile(std::string const &path) {
+#ifdef _WIN32
+    auto const file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+      return;
+    }
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+      mapping_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (mapping_ != nullptr) {
+        data_ = MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+        size_ = data_ != nullptr ? static_cast<std::size_t>(size.QuadPart) : 0;
+      }
+    }
+    CloseHandle(file);
+#else
+    auto const file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+      return;
+    }
+    struct stat status {};
+    if (::fstat(file, &status) == 0 && status.st_size > 0) {
+      auto const size = static_cast<std::size_t>(status.st_size);
+      auto *const data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+      if (data != MAP_FAILED) {
+        data_ = data;
+        size_ = size;
+      }
+    }
+    ::close(file);
+#endif
+  }
+
+  MappedFile(MappedFile const &)            = delete;
+  MappedFile &operator=(MappedFile const &) = delete;
+
+  ~MappedFile() {
+#ifdef _WIN32
+    if (data_ != nullptr) {
+      UnmapViewOfFile(data_);
+    }
+    if (mapping_ != nullptr) {
+      CloseHandle(mapping_);
+    }
+#else
+    if (data_ != nullptr) {
+      ::munmap(data_, size_);
+    }
+#endif
+  }
+
+  [[nodiscard]] bool isOpen() const { return data_ != nullptr; }
+
+  [[nodiscard]] std::span<std::byte const> bytes() const {
+    return {static_cast<std::byte const *>(data_), size_};
+  }
+
+private:
+  void *data_       = nullptr;
+  std::size_t size_ = 0;
+#ifdef _WIN32
+  HANDLE mapping_ = nullptr;
+#endif
+};
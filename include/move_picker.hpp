@@ -0,0 +1,286 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+
+// ---
+#define CHESS_NO_EXCEPTIONS
+#include <chess.hpp>
+// ---
+
+// MVV_LVA_LUT[attacker][victim]
+constexpr std::array<std::array<int, 7>, 7> MVV_LVA_LUT{{
+    {{15, 25, 35, 45, 55, 0, 0}}, // PAWN
+    {{14, 24, 34, 44, 54, 0, 0}}, // KNIGHT
+    {{13, 23, 33, 43, 53, 0, 0}}, // BISHOP
+    {{12, 22, 32, 42, 52, 0, 0}}, // ROOK
+    {{11, 21, 31, 41, 51, 0, 0}}, // QUEEN
+    {{10, 20, 30, 40, 50, 0, 0}}, // KING
+    {{0, 0, 0, 0, 0, 0, 0}}       // NONE (EMPTY)
+}};
+
+// Piece values used by the static exchange evaluation, indexed by chess::PieceType
+constexpr std::array<int, 7> SEE_VALUES{100, 320, 330, 500, 900, 20000, 0};
+
+[[nodiscard]] inline constexpr int seeValue(chess::PieceType type) { return SEE_VALUES[type]; }
+
+// Butterfly history, indexed by [color][from][to]. Bounded by HISTORY_MAX.
+using ButterflyHistory = std::array<std::array<std::array<int, 64>, 64>, 2>;
+// Two killer moves per ply: quiet moves that recently caused a beta cutoff at that ply
+using KillerMoves = std::array<chess::Move, 2>;
+
+constexpr int HISTORY_MAX = 10000;
+
+[[nodiscard]] inline bool isQuiet(chess::Board const &board, chess::Move const &move) {
+  return move.typeOf() != chess::Move::PROMOTION && not board.isCapture(move);
+}
+
+// Moves a history entry towards +-HISTORY_MAX, by less the closer it already is
+inline void updateHistory(int &entry, int bonus) {
+  auto const clamped = std::clamp(bonus, -HISTORY_MAX, HISTORY_MAX);
+  entry += clamped - entry * std::abs(clamped) / HISTORY_MAX;
+}
+
+[[nodiscard]] inline int moveHeuristic(chess::Move const &move, chess::Board const &board) {
+  // MVV-LVA Most Valuable Victim, Least Valuable Attacker
+  auto const attacker_type = board.at(move.from()).type();
+  auto const victim_type   = move.typeOf() == chess::Move::ENPASSANT
+                                 ? chess::PieceType(chess::PieceType::PAWN)
+                                 : board.at(move.to()).type();
+  return MVV_LVA_LUT[attacker_type][victim_type];
+}
+
+[[nodiscard]] inline chess::Bitboard attackersTo(chess::Board const &board, chess::Square square,
+                                                 chess::Bitboard occupied) {
+  using chess::attacks;
+  using chess::Color;
+  using chess::PieceType;
+  auto const bishops = board.pieces(PieceType::BISHOP) | board.pieces(PieceType::QUEEN);
+  auto const rooks   = board.pieces(PieceType::ROOK) | board.pieces(PieceType::QUEEN);
+  return (attacks::pawn(Color::BLACK, square) & board.pieces(PieceType::PAWN, Color::WHITE)) |
+         (attacks::pawn(Color::WHITE, square) & board.pieces(PieceType::PAWN, Color::BLACK)) |
+         (attacks::knight(square) & board.pieces(PieceType::KNIGHT)) |
+         (attacks::bishop(square, occupied) & bishops) | (attacks::rook(square, occupied) & rooks) |
+         (attacks::king(square) & board.pieces(PieceType::KING));
+}
+
+// Static exchange evaluation: does the capture sequence started by this move win at least
+// threshold, assuming both sides always recapture with their least valuable piece?
+[[nodiscard]] inline bool seeGe(chess::Board const &board, chess::Move const &move, int threshold) {
+  using chess::attacks;
+  using chess::Bitboard;
+  using chess::PieceType;
+
+  // Castling, en passant and promotions are treated as even trades
+  if (move.typeOf() != chess::Move::NORMAL) {
+    return threshold <= 0;
+  }
+
+  auto const from = move.from();
+  auto const to   = move.to();
+
+  int swap = seeValue(board.at<PieceType>(to)) - threshold;
+  if (swap < 0) {
+    return false;
+  }
+  swap = seeValue(board.at<PieceType>(from)) - swap;
+  if (swap <= 0) {
+    return true;
+  }
+
+  auto const bishops = board.pieces(PieceType::BISHOP) | board.pieces(PieceType::QUEEN);
+  auto const rooks   = board.pieces(PieceType::ROOK) | board.pieces(PieceType::QUEEN);
+
+  auto occupied  = board.occ() ^ Bitboard::fromSquare(from) ^ Bitboard::fromSquare(to);
+  auto stm       = board.at(from).color();
+  auto attackers = attackersTo(board, to, occupied);
+  int result     = 1;
+
+  while (true) {
+    stm = ~stm;
+    attackers &= occupied;
+
+    auto const stm_attackers = attackers & board.us(stm);
+    if (not stm_attackers) {
+      break;
+    }
+    result ^= 1;
+
+    // Capture with the least valuable attacker and add the sliders it uncovers
+    Bitboard least;
+    if ((least = stm_attackers & board.pieces(PieceType::PAWN))) {
+      if ((swap = seeValue(PieceType::PAWN) - swap) < result) {
+        break;
+      }
+      occupied ^= Bitboard::fromSquare(least.lsb());
+      attackers |= attacks::bishop(to, occupied) & bishops;
+    } else if ((least = stm_attackers & board.pieces(PieceType::KNIGHT))) {
+      if ((swap = seeValue(PieceType::KNIGHT) - swap) < result) {
+        break;
+      }
+      occupied ^= Bitboard::fromSquare(least.lsb());
+    } else if ((least = stm_attackers & board.pieces(PieceType::BISHOP))) {
+      if ((swap = seeValue(PieceType::BISHOP) - swap) < result) {
+        break;
+      }
+      occupied ^= Bitboard::fromSquare(least.lsb());
+      attackers |= attacks::bishop(to, occupied) & bishops;
+    } else if ((least = stm_attackers & board.pieces(PieceType::ROOK))) {
+      if ((swap = seeValue(PieceType::ROOK) - swap) < result) {
+        break;
+      }
+      occupied ^= Bitboard::fromSquare(least.lsb());
+      attackers |= attacks::rook(to, occupied) & rooks;
+    } else if ((least = stm_attackers & board.pieces(PieceType::QUEEN))) {
+      if ((swap = seeValue(PieceType::QUEEN) - swap) < result) {
+        break;
+      }
+      occupied ^= Bitboard::fromSquare(least.lsb());
+      attackers |=
+          (attacks::bishop(to, occupied) & bishops) | (attacks::rook(to, occupied) & rooks);
+    } else {
+      // The king can only recapture if the opponent has no attackers left
+      return (attackers & ~board.us(stm)) ? result ^ 1 : result;
+    }
+  }
+
+  return result != 0;
+}
+
+// Hands out the moves of a node best first. Every move is scored once into Move::score() and
+// moves are then picked by lazy selection sort, so a cutoff on an early move never pays for
+// ordering the rest of the list. The score bands below define the stages.
+class MovePicker {
+public:
+  enum class Stage : std::uint8_t {
+    TT_MOVE,
+    SCORE,
+    GOOD_CAPTURES,
+    KILLERS,
+    QUIETS,
+    BAD_CAPTURES,
+    END
+  };
+
+  static constexpr std::int16_t GOOD_CAPTURE_SCORE = 30000;
+  static constexpr std::int16_t KILLER_SCORE       = 20000;
+  static constexpr std::int16_t BAD_CAPTURE_SCORE  = -30000;
+
+  // Killers and history are optional, quiescence search only needs the captures ordered.
+  MovePicker(chess::Movelist &moves, chess::Board const &board,
+             chess::Move tt_move = chess::Move::NO_MOVE, KillerMoves const *killers = nullptr,
+             ButterflyHistory const *history = nullptr)
+      : moves_(moves), board_(board), tt_move_(tt_move), killers_(killers), history_(history) {}
+
+  // Returns chess::Move::NO_MOVE once all moves have been handed out.
+  [[nodiscard]] chess::Move next() {
+    chess::Move move;
+    switch (stage_) {
+    case Stage::TT_MOVE:
+      stage_ = Stage::SCORE;
+      if (tt_move_ != chess::Move::NO_MOVE) {
+        auto const it = std::find(moves_.begin(), moves_.end(), tt_move_);
+        if (it != moves_.end()) {
+          std::iter_swap(moves_.begin(), it);
+          current_    = 1;
+          last_stage_ = Stage::TT_MOVE;
+          return tt_move_;
+        }
+      }
+      [[fallthrough]];
+    case Stage::SCORE:
+      score();
+      stage_ = Stage::GOOD_CAPTURES;
+      [[fallthrough]];
+    case Stage::GOOD_CAPTURES:
+      if (select(GOOD_CAPTURE_SCORE, move)) {
+        return move;
+      }
+      stage_ = Stage::KILLERS;
+      [[fallthrough]];
+    case Stage::KILLERS:
+      if (select(KILLER_SCORE - 1, move)) {
+        return move;
+      }
+      stage_ = Stage::QUIETS;
+      [[fallthrough]];
+    case Stage::QUIETS:
+      // History scores stay within +-HISTORY_MAX, far above the bad capture band
+      if (select(BAD_CAPTURE_SCORE / 2, move)) {
+        return move;
+      }
+      stage_ = Stage::BAD_CAPTURES;
+      [[fallthrough]];
+    case Stage::BAD_CAPTURES:
+      if (select(std::numeric_limits<std::int16_t>::min(), move)) {
+        return move;
+      }
+      stage_ = Stage::END;
+      [[fallthrough]];
+    case Stage::END:
+      break;
+    }
+    return chess::Move::NO_MOVE;
+  }
+
+  // Stage of the move returned by the last call to next()
+  [[nodiscard]] Stage stage() const { return last_stage_; }
+
+private:
+  void score() {
+    for (auto i = current_; i < moves_.size(); ++i) {
+      auto &move = moves_[i];
+      if (move.typeOf() == chess::Move::PROMOTION) {
+        // Queen promotions go with the good captures, under-promotions are almost never best
+        move.setScore(move.promotionType() == chess::PieceType::QUEEN
+                          ? GOOD_CAPTURE_SCORE + 100 + moveHeuristic(move, board_)
+                          : BAD_CAPTURE_SCORE);
+      } else if (board_.isCapture(move)) {
+        auto const mvv_lva = moveHeuristic(move, board_);
+        move.setScore(seeGe(board_, move, 0) ? GOOD_CAPTURE_SCORE + mvv_lva
+                                             : BAD_CAPTURE_SCORE + mvv_lva);
+      } else if (killers_ != nullptr && move == (*killers_)[0]) {
+        move.setScore(KILLER_SCORE);
+      } else if (killers_ != nullptr && move == (*killers_)[1]) {
+        move.setScore(KILLER_SCORE - 1);
+      } else if (history_ != nullptr) {
+        auto const color = board_.sideToMove();
+        move.setScore(static_cast<std::int16_t>(
+            (*history_)[color][move.from().index()][move.to().index()]));
+      } else {
+        move.setScore(0);
+      }
+    }
+  }
+
+  // Moves the best remaining move to the front if its score is at least min_score.
+  [[nodiscard]] bool select(int min_score, chess::Move &move) {
+    if (current_ >= moves_.size()) {
+      return false;
+    }
+    auto best = moves_.begin() + current_;
+    for (auto it = best + 1; it != moves_.end(); ++it) {
+      if (it->score() > best->score()) {
+        best = it;
+      }
+    }
+    if (best->score() < min_score) {
+      return false;
+    }
+    std::iter_swap(moves_.begin() + current_, best);
+    move        = moves_[current_++];
+    last_stage_ = stage_;
+    return true;
+  }
+
+  chess::Movelist &moves_;
+  chess::Board const &board_;
+  chess::Move tt_move_;
+  KillerMoves const *killers_;
+  ButterflyHistory const *history_;
+  int current_      = 0;
+  Stage stage_      = Stage::TT_MOVE;
+  Stage last_stage_ = Stage::TT_MOVE;
+};
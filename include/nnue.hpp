@@ -0,0 +1,256 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(__AVX512BW__) || defined(__AVX2__)
+#  include <immintrin.h>
+#elif defined(__ARM_NEON)
+#  include <arm_neon.h>
+#endif
+
+#include "evaluation.hpp"
+
+// ---
+#define CHESS_NO_EXCEPTIONS
+#include <chess.hpp>
+// ---
+
+// Efficiently updatable neural network evaluation, an alternative to the handcrafted one.
+//
+// Architecture: HalfKP (king square x non-king piece x square) -> 2 x NNUE_HIDDEN -> 1. The
+// feature transformer output of the side to move and of the opponent are concatenated, clipped
+// to [0, NNUE_QA] and fed to a single output neuron. Feature transformer sums are kept per node
+// in an accumulator that only adds and subtracts the weight rows of the pieces that moved.
+//
+// Weight file, little endian:
+//   uint32 magic (NNUE_MAGIC), uint32 version (NNUE_VERSION), uint32 inputs, uint32 hidden
+//   int16  feature transformer biases [hidden]
+//   int16  feature transformer weights [inputs][hidden]
+//   int16  output weights [2 * hidden], side to move first
+//   int32  output bias
+// The output is (sum + bias) * NNUE_SCALE / (NNUE_QA * NNUE_QB) centipawns.
+
+constexpr std::size_t NNUE_INPUTS = 64 * 10 * 64;
+constexpr std::size_t NNUE_HIDDEN = 256;
+
+constexpr int NNUE_QA    = 255;
+constexpr int NNUE_QB    = 64;
+constexpr int NNUE_SCALE = 400;
+
+constexpr std::uint32_t NNUE_MAGIC   = 0x45554E4E; // "NNUE"
+constexpr std::uint32_t NNUE_VERSION = 1;
+
+// Feature transformer output for both perspectives, indexed by chess::Color
+struct NnueAccumulator {
+  alignas(64) std::array<std::array<std::int16_t, NNUE_HIDDEN>, 2> values;
+};
+
+// Vector kernels over NNUE_HIDDEN int16 lanes, picked at compile time
+inline void nnueAddRow(std::int16_t *acc, std::int16_t const *row) {
+#if defined(__AVX512BW__)
+  for (std::size_t i = 0; i < NNUE_HIDDEN; i += 32) {
+    auto const a = _mm512_loadu_si512(acc + i);
+    auto const r = _mm512_loadu_si512(row + i);
+    _mm512_storeu_si512(acc + i, _mm512_add_epi16(a, r));
+  }
+#elif defined(__AVX2__)
+  for (std::size_t i = 0; i < NNUE_HIDDEN; i += 16) {
+    auto const a = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(acc + i));
+    auto const r = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(row + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(acc + i), _mm256_add_epi16(a, r));
+  }
+#elif defined(__ARM_NEON)
+  for (std::size_t i = 0; i < NNUE_HIDDEN; i += 8) {
+    vst1q_s16(acc + i, vaddq_s16(vld1q_s16(acc + i), vld1q_s16(row + i)));
+  }
+#else
+  for (std::size_t i = 0; i < NNUE_HIDDEN; ++i) {
+    acc[i] = static_cast<std::int16_t>(acc[i] + row[i]);
+  }
+#endif
+}
+
+inline void nnueSubRow(std::int16_t *acc, std::int16_t const *row) {
+#if defined(__AVX512BW__)
+  for (std::size_t i = 0; i < NNUE_HIDDEN; i += 32) {
+    auto const a = _mm512_loadu_si512(acc + i);
+    auto const r = _mm512_loadu_si512(row + i);
+    _mm512_storeu_si512(acc + i, _mm512_sub_epi16(a, r));
+  }
+#elif defined(__AVX2__)
+  for (std::size_t i = 0; i < NNUE_HIDDEN; i += 16) {
+    auto const a = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(acc + i));
+    auto const r = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(row + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(acc + i), _mm256_sub_epi16(a, r));
+  }
+#elif defined(__ARM_NEON)
+  for (std::size_t i = 0; i < NNUE_HIDDEN; i += 8) {
+    vst1q_s16(acc + i, vsubq_s16(vld1q_s16(acc + i), vld1q_s16(row + i)));
+  }
+#else
+  for (std::size_t i = 0; i < NNUE_HIDDEN; ++i) {
+    acc[i] = static_cast<std::int16_t>(acc[i] - row[i]);
+  }
+#endif
+}
+
+// Sum of clamp(acc[i], 0, NNUE_QA) * weights[i]
+[[nodiscard]] inline std::int32_t nnueClippedDot(std::int16_t const *acc,
+                                                 std::int16_t const *weights) {
+#if defined(__AVX512BW__)
+  auto const zero = _mm512_setzero_si512();
+  auto const qa   = _mm512_set1_epi16(NNUE_QA);
+  auto sum        = _mm512_setzero_si512();
+  for (std::size_t i = 0; i < NNUE_HIDDEN; i += 32) {
+    auto const a = _mm512_min_epi16(_mm512_max_epi16(_mm512_loadu_si512(acc + i), zero), qa);
+    sum = _mm512_add_epi32(sum, _mm512_madd_epi16(a, _mm512_loadu_si512(weights + i)));
+  }
+  return _mm512_reduce_add_epi32(sum);
+#elif defined(__AVX2__)
+  auto const zero = _mm256_setzero_si256();
+  auto const qa   = _mm256_set1_epi16(NNUE_QA);
+  auto sum        = _mm256_setzero_si256();
+  for (std::size_t i = 0; i < NNUE_HIDDEN; i += 16) {
+    auto a = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(acc + i));
+    a      = _mm256_min_epi16(_mm256_max_epi16(a, zero), qa);
+    auto const w = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(weights + i));
+    sum          = _mm256_add_epi32(sum, _mm256_madd_epi16(a, w));
+  }
+  auto const half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+  auto const quad = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+  auto const pair = _mm_add_epi32(quad, _mm_shuffle_epi32(quad, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(pair);
+#elif defined(__ARM_NEON)
+  auto const zero = vdupq_n_s16(0);
+  auto const qa   = vdupq_n_s16(NNUE_QA);
+  auto sum        = vdupq_n_s32(0);
+  for (std::size_t i = 0; i < NNUE_HIDDEN; i += 8) {
+    auto const a = vminq_s16(vmaxq_s16(vld1q_s16(acc + i), zero), qa);
+    auto const w = vld1q_s16(weights + i);
+    sum          = vmlal_s16(sum, vget_low_s16(a), vget_low_s16(w));
+    sum          = vmlal_s16(sum, vget_high_s16(a), vget_high_s16(w));
+  }
+  return vaddvq_s32(sum);
+#else
+  std::int32_t sum = 0;
+  for (std::size_t i = 0; i < NNUE_HIDDEN; ++i) {
+    sum += std::clamp<std::int32_t>(acc[i], 0, NNUE_QA) * weights[i];
+  }
+  return sum;
+#endif
+}
+
+// Read-only after loading, shared by all search threads
+class NnueNetwork {
+public:
+  // Returns nullptr if the file can't be read or was written for a different architecture
+  [[nodiscard]] static std::unique_ptr<NnueNetwork> load(std::string const &path) {
+    std::ifstream file(path, std::ios::binary);
+    std::array<std::uint32_t, 4> header{};
+    file.read(reinterpret_cast<char *>(header.data()), sizeof(header));
+    if (not file || header[0] != NNUE_MAGIC || header[1] != NNUE_VERSION ||
+        header[2] != NNUE_INPUTS || header[3] != NNUE_HIDDEN) {
+      return nullptr;
+    }
+
+    auto network = std::unique_ptr<NnueNetwork>(new NnueNetwork());
+    auto read    = [&file](auto &values) {
+      file.read(reinterpret_cast<char *>(values.data()),
+                static_cast<std::streamsize>(values.size() * sizeof(values[0])));
+    };
+    read(network->ft_biases_);
+    read(network->ft_weights_);
+    read(network->out_weights_);
+    file.read(reinterpret_cast<char *>(&network->out_bias_), sizeof(network->out_bias_));
+    // Nothing may be missing and nothing may follow
+    if (not file || file.peek() != std::ifstream::traits_type::eof()) {
+      return nullptr;
+    }
+    return network;
+  }
+
+  // Computes both perspectives from scratch
+  void refresh(NnueAccumulator &acc, chess::Board const &board) const {
+    refresh(acc, board, chess::Color::WHITE);
+    refresh(acc, board, chess::Color::BLACK);
+  }
+
+  // Derives the child accumulator from its parent. The board is the one after the move. A king
+  // move changes every feature of its own perspective, which is then recomputed instead.
+  void update(NnueAccumulator const &parent, NnueAccumulator &child, MoveDelta const &delta,
+              chess::Board const &board) const {
+    constexpr std::array<chess::Color, 2> perspectives{chess::Color::WHITE, chess::Color::BLACK};
+    for (auto const perspective : perspectives) {
+      auto const own_king = chess::Piece(chess::PieceType::KING, perspective);
+      if (delta.removed[0].piece == own_king) {
+        refresh(child, board, perspective);
+        continue;
+      }
+
+      child.values[perspective] = parent.values[perspective];
+
+      auto *values    = child.values[perspective].data();
+      auto const king = board.kingSq(perspective);
+      for (int i = 0; i < delta.num_removed; ++i) {
+        auto const &entry = delta.removed[i];
+        if (entry.piece.type() != chess::PieceType::KING) {
+          nnueSubRow(values, row(featureIndex(perspective, king, entry.piece, entry.square)));
+        }
+      }
+      for (int i = 0; i < delta.num_added; ++i) {
+        auto const &entry = delta.added[i];
+        if (entry.piece.type() != chess::PieceType::KING) {
+          nnueAddRow(values, row(featureIndex(perspective, king, entry.piece, entry.square)));
+        }
+      }
+    }
+  }
+
+  // Score in centipawns from the point of view of the side to move
+  [[nodiscard]] int evaluate(NnueAccumulator const &acc, chess::Color side_to_move) const {
+    auto const sum = nnueClippedDot(acc.values[side_to_move].data(), out_weights_.data()) +
+                     nnueClippedDot(acc.values[~side_to_move].data(),
+                                    out_weights_.data() + NNUE_HIDDEN);
+    return static_cast<int>((static_cast<std::int64_t>(sum) + out_bias_) * NNUE_SCALE /
+                            (NNUE_QA * NNUE_QB));
+  }
+
+private:
+  NnueNetwork()
+      : ft_biases_(NNUE_HIDDEN), ft_weights_(NNUE_INPUTS * NNUE_HIDDEN),
+        out_weights_(2 * NNUE_HIDDEN) {}
+
+  // Squares are mirrored vertically for black so both perspectives share the weights
+  [[nodiscard]] static std::size_t featureIndex(chess::Color perspective, chess::Square king,
+                                                chess::Piece piece, chess::Square square) {
+    auto const flip        = perspective == chess::Color::WHITE ? 0 : 56;
+    auto const piece_index = static_cast<int>(piece.type()) * 2 + (piece.color() != perspective);
+    return (static_cast<std::size_t>(king.index() ^ flip) * 10 + piece_index) * 64 +
+           (square.index() ^ flip);
+  }
+
+  [[nodiscard]] std::int16_t const *row(std::size_t feature) const {
+    return ft_weights_.data() + feature * NNUE_HIDDEN;
+  }
+
+  void refresh(NnueAccumulator &acc, chess::Board const &board, chess::Color perspective) const {
+    auto *values    = acc.values[perspective].data();
+    auto const king = board.kingSq(perspective);
+    std::copy(ft_biases_.begin(), ft_biases_.end(), values);
+    auto pieces = board.occ() & ~board.pieces(chess::PieceType::KING);
+    while (pieces) {
+      auto const square = chess::Square(pieces.pop());
+      nnueAddRow(values, row(featureIndex(perspective, king, board.at(square), square)));
+    }
+  }
+
+  std::vector<std::int16_t> ft_biases_;
+  std::vector<std::int16_t> ft_weights_;
+  std::vector<std::int16_t> out_weights_;
+  std::int32_t out_bias_ = 0;
+};
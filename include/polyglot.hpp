@@ -0,0 +1,149 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <span>
+#include <string>
+
+#include "mapped_file.hpp"
+
+// ---
+#define CHESS_NO_EXCEPTIONS
+#include <chess.hpp>
+// ---
+
+// Polyglot opening books are arrays of 16-byte big-endian entries sorted by key. The key is the
+// Polyglot Zobrist hash, which is exactly what chess::Board::hash() computes.
+struct PolyglotEntry {
+  std::uint64_t key    = 0;
+  std::uint16_t move   = 0;
+  std::uint16_t weight = 0;
+  std::uint32_t learn  = 0;
+};
+
+constexpr std::size_t POLYGLOT_ENTRY_SIZE = 16;
+
+// Polyglot packs to and from square as file and rank bits and the promotion piece as 1 (knight)
+// to 4 (queen). Castling is written as the king capturing its rook, which is also how
+// chess::Move encodes it.
+[[nodiscard]] inline std::uint16_t polyglotMove(chess::Move const &move) {
+  auto const from = move.from();
+  auto const to   = move.to();
+  std::uint16_t encoded =
+      static_cast<std::uint16_t>(int(to.file()) | int(to.rank()) << 3 | int(from.file()) << 6 |
+                                 int(from.rank()) << 9);
+  if (move.typeOf() == chess::Move::PROMOTION) {
+    encoded |= static_cast<std::uint16_t>(int(move.promotionType()) << 12);
+  }
+  return encoded;
+}
+
+[[nodiscard]] inline std::array<std::uint8_t, POLYGLOT_ENTRY_SIZE>
+storePolyglotEntry(PolyglotEntry const &entry) {
+  std::array<std::uint8_t, POLYGLOT_ENTRY_SIZE> bytes{};
+  for (int i = 0; i < 8; ++i) {
+    bytes[i] = static_cast<std::uint8_t>(entry.key >> (56 - 8 * i));
+  }
+  bytes[8]  = static_cast<std::uint8_t>(entry.move >> 8);
+  bytes[9]  = static_cast<std::uint8_t>(entry.move);
+  bytes[10] = static_cast<std::uint8_t>(entry.weight >> 8);
+  bytes[11] = static_cast<std::uint8_t>(entry.weight);
+  for (int i = 0; i < 4; ++i) {
+    bytes[12 + i] = static_cast<std::uint8_t>(entry.learn >> (24 - 8 * i));
+  }
+  return bytes;
+}
+
+[[nodiscard]] inline PolyglotEntry loadPolyglotEntry(std::span<std::byte const> bytes,
+                                                     std::size_t index) {
+  auto const data = bytes.subspan(index * POLYGLOT_ENTRY_SIZE, POLYGLOT_ENTRY_SIZE);
+  auto const byte = [&data](std::size_t i) { return std::to_integer<std::uint64_t>(data[i]); };
+  PolyglotEntry entry;
+  for (std::size_t i = 0; i < 8; ++i) {
+    entry.key = entry.key << 8 | byte(i);
+  }
+  entry.move   = static_cast<std::uint16_t>(byte(8) << 8 | byte(9));
+  entry.weight = static_cast<std::uint16_t>(byte(10) << 8 | byte(11));
+  entry.learn  = static_cast<std::uint32_t>(byte(12) << 24 | byte(13) << 16 | byte(14) << 8 |
+                                           byte(15));
+  return entry;
+}
+
+// Memory-mapped Polyglot book. Probing is a binary search over the mapped entries, so opening
+// a book costs nothing up front and its pages are shared by every engine process using it.
+class PolyglotBook {
+public:
+  // Returns nullptr if the file can't be opened or isn't made of whole entries
+  [[nodiscard]] static std::unique_ptr<PolyglotBook const> open(std::string const &path) {
+    auto book = std::unique_ptr<PolyglotBook>(new PolyglotBook(path));
+    auto const size = book->file_.bytes().size();
+    if (not book->file_.isOpen() || size % POLYGLOT_ENTRY_SIZE != 0) {
+      return nullptr;
+    }
+    return book;
+  }
+
+  // Picks one of the position's book moves with probability proportional to its weight.
+  // Returns chess::Move::NO_MOVE if the position isn't in the book.
+  template <class Generator>
+  [[nodiscard]] chess::Move probe(chess::Board const &board, Generator &generator) const {
+    auto const bytes = file_.bytes();
+    auto const key   = board.hash();
+
+    // First entry with the key
+    std::size_t first = 0;
+    std::size_t count = bytes.size() / POLYGLOT_ENTRY_SIZE;
+    while (count > 0) {
+      auto const step = count / 2;
+      if (loadPolyglotEntry(bytes, first + step).key < key) {
+        first += step + 1;
+        count -= step + 1;
+      } else {
+        count = step;
+      }
+    }
+
+    chess::Movelist legal_moves;
+    chess::movegen::legalmoves(legal_moves, board);
+
+    // Entries are matched against the legal moves, which also guards against hash collisions
+    std::array<chess::Move, chess::constants::MAX_MOVES> moves;
+    std::array<std::uint32_t, chess::constants::MAX_MOVES> weights{};
+    std::size_t size         = 0;
+    std::uint32_t total      = 0;
+    auto const entries_count = bytes.size() / POLYGLOT_ENTRY_SIZE;
+    for (auto i = first; i < entries_count && size < moves.size(); ++i) {
+      auto const entry = loadPolyglotEntry(bytes, i);
+      if (entry.key != key) {
+        break;
+      }
+      for (auto const &move : legal_moves) {
+        if (polyglotMove(move) == entry.move && entry.weight != 0) {
+          moves[size]   = move;
+          weights[size] = entry.weight;
+          total += entry.weight;
+          ++size;
+          break;
+        }
+      }
+    }
+    if (total == 0) {
+      return chess::Move::NO_MOVE;
+    }
+
+    auto pick = std::uniform_int_distribution<std::uint32_t>(0, total - 1)(generator);
+    for (std::size_t i = 0;; ++i) {
+      if (pick < weights[i]) {
+        return moves[i];
+      }
+      pick -= weights[i];
+    }
+  }
+
+private:
+  explicit PolyglotBook(std::string const &path) : file_(path) {}
+
+  MappedFile file_;
+};
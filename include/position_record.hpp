@@ -0,0 +1,86 @@
+#pragma once
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <type_traits>
+
+// ---
+#define CHESS_NO_EXCEPTIONS
+#include <chess.hpp>
+// ---
+
+// Fixed-size binary record of a position and, once analysed, the engine's verdict on it. Files
+// are plain arrays of records in little-endian byte order, so they can be mapped and indexed
+// without parsing. Unanalysed records have all of score, move and depth zero.
+struct PositionRecord {
+  // Board::Compact encoding, which doesn't keep the move counters
+  chess::PackedBoard board{};
+  // From the point of view of the side to move
+  std::int32_t score = 0;
+  // chess::Move::move(), chess::Move::NO_MOVE if the position has no legal moves
+  std::uint16_t move = 0;
+  std::uint8_t depth = 0;
+  std::uint8_t reserved = 0;
+};
+
+static_assert(sizeof(PositionRecord) == 32);
+static_assert(std::is_trivially_copyable_v<PositionRecord>);
+static_assert(std::endian::native == std::endian::little,
+              "Position records are stored in little-endian byte order");
+
+// Number of whole records in a buffer, a truncated record at the end is ignored
+[[nodiscard]] inline std::size_t recordCount(std::span<std::byte const> bytes) {
+  return bytes.size() / sizeof(PositionRecord);
+}
+
+// Copies the record out, so the buffer doesn't need to be aligned
+[[nodiscard]] inline PositionRecord readRecord(std::span<std::byte const> bytes,
+                                               std::size_t index) {
+  PositionRecord record;
+  std::memcpy(&record, bytes.data() + index * sizeof(PositionRecord), sizeof(PositionRecord));
+  return record;
+}
+
+// Whether Board::Compact::decode can read the board, which it doesn't check itself: at most 32
+// pieces, one king per side, at most one pawn marking an en passant square and on the fourth or
+// fifth rank, and at most two rooks per side marked with castling rights. The decoded board can
+// still be illegal, isValidFen on its FEN tells.
+[[nodiscard]] inline bool isValidPackedBoard(chess::PackedBoard const &packed) {
+  std::uint64_t occupied = 0;
+  for (int i = 0; i < 8; ++i) {
+    occupied |= std::uint64_t{packed[i]} << (56 - i * 8);
+  }
+  if (std::popcount(occupied) > 32) {
+    return false;
+  }
+
+  // Nibbles follow the occupied squares from a1 up, as in Compact::decode
+  constexpr auto WHITE_KING = static_cast<unsigned>(chess::Piece::WHITEKING);
+  constexpr auto BLACK_KING = static_cast<unsigned>(chess::Piece::BLACKKING);
+  int white_kings    = 0;
+  int black_kings    = 0;
+  int en_passant     = 0;
+  int white_castling = 0;
+  int black_castling = 0;
+  for (int offset = 16; occupied != 0; ++offset, occupied &= occupied - 1) {
+    auto const rank   = std::countr_zero(occupied) / 8;
+    auto const nibble = (packed[offset / 2] >> (offset % 2 == 0 ? 4 : 0)) & 0xFU;
+    if (nibble == WHITE_KING) {
+      ++white_kings;
+    } else if (nibble == BLACK_KING || nibble == 15) {
+      ++black_kings;
+    } else if (nibble == 12) {
+      ++en_passant;
+      if (rank != 3 && rank != 4) {
+        return false;
+      }
+    } else if (nibble == 13) {
+      ++white_castling;
+    } else if (nibble == 14) {
+      ++black_castling;
+    }
+  }
+  return white_kings == 1 && black_kings == 1 && en_passant <= 1 && white_castling <= 2 &&
+         black_castling <= 2;
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+// Time spent in move generation and evaluation is only measured when built with
+// -DCHESS_AI_PROFILE=ON, reading the clock around every call costs about as much as the call.
+#ifdef CHESS_AI_PROFILE
+constexpr bool PROFILE = true;
+#else
+constexpr bool PROFILE = false;
+#endif
+
+// Iteration depths the per-depth node counts cover
+constexpr std::size_t STATS_MAX_DEPTH = 128;
+
+// Counters of a single search. Every worker counts into its own copy, which are summed once the
+// search is over, so the search itself never touches shared memory for them.
+struct SearchStats {
+  std::uint64_t nodes  = 0; // Including quiescence nodes
+  std::uint64_t qnodes = 0;
+  // Main search nodes that probed the table, found their position in it and returned its score
+  std::uint64_t tt_probes  = 0;
+  std::uint64_t tt_hits    = 0;
+  std::uint64_t tt_cutoffs = 0;
+  std::uint64_t tb_hits    = 0;
+  // Beta cutoffs in the main search, and how many of them the first move searched caused
+  std::uint64_t cutoffs            = 0;
+  std::uint64_t first_move_cutoffs = 0;
+  // Nodes spent on each iteration depth, aspiration re-searches included
+  std::array<std::uint64_t, STATS_MAX_DEPTH> depth_nodes{};
+  // Only measured with CHESS_AI_PROFILE
+  std::uint64_t movegen_ns = 0;
+  std::uint64_t eval_ns    = 0;
+  std::chrono::milliseconds time{0};
+
+  SearchStats &operator+=(SearchStats const &other) {
+    nodes += other.nodes;
+    qnodes += other.qnodes;
+    tt_probes += other.tt_probes;
+    tt_hits += other.tt_hits;
+    tt_cutoffs += other.tt_cutoffs;
+    tb_hits += other.tb_hits;
+    cutoffs += other.cutoffs;
+    first_move_cutoffs += other.first_move_cutoffs;
+    for (std::size_t depth = 0; depth < STATS_MAX_DEPTH; ++depth) {
+      depth_nodes[depth] += other.depth_nodes[depth];
+    }
+    movegen_ns += other.movegen_ns;
+    eval_ns += other.eval_ns;
+    time += other.time;
+    return *this;
+  }
+
+  [[nodiscard]] std::uint64_t nps() const {
+    return nodes * 1000 / std::max<std::uint64_t>(static_cast<std::uint64_t>(time.count()), 1);
+  }
+
+  [[nodiscard]] double ttHitRate() const { return ratio(tt_hits, tt_probes); }
+  [[nodiscard]] double ttCutoffRate() const { return ratio(tt_cutoffs, tt_probes); }
+  [[nodiscard]] double firstMoveCutoffRate() const { return ratio(first_move_cutoffs, cutoffs); }
+
+  // How many times the nodes of the previous depth this depth took, 0 without both
+  [[nodiscard]] double branchingFactor(std::size_t depth) const {
+    if (depth == 0 || depth >= STATS_MAX_DEPTH) {
+      return 0.0;
+    }
+    return ratio(depth_nodes[depth], depth_nodes[depth - 1]);
+  }
+
+private:
+  [[nodiscard]] static double ratio(std::uint64_t count, std::uint64_t total) {
+    return total == 0 ? 0.0 : static_cast<double>(count) / static_cast<double>(total);
+  }
+};
+
+// One line of JSON without a trailing newline, for logs with a search per line
+[[nodiscard]] inline std::string searchStatsJson(SearchStats const &stats) {
+  std::ostringstream json;
+  json << "{\"nodes\":" << stats.nodes << ",\"qnodes\":" << stats.qnodes
+       << ",\"time_ms\":" << stats.time.count() << ",\"nps\":" << stats.nps()
+       << ",\"tt_probes\":" << stats.tt_probes << ",\"tt_hit_rate\":" << stats.ttHitRate()
+       << ",\"tt_cutoff_rate\":" << stats.ttCutoffRate() << ",\"tb_hits\":" << stats.tb_hits
+       << ",\"cutoffs\":" << stats.cutoffs
+       << ",\"first_move_cutoff_rate\":" << stats.firstMoveCutoffRate();
+  if constexpr (PROFILE) {
+    json << ",\"movegen_us\":" << stats.movegen_ns / 1000
+         << ",\"eval_us\":" << stats.eval_ns / 1000;
+  }
+  json << ",\"depths\":[";
+  bool first = true;
+  for (std::size_t depth = 1; depth < STATS_MAX_DEPTH; ++depth) {
+    if (stats.depth_nodes[depth] == 0) {
+      continue;
+    }
+    json << (first ? "" : ",") << "{\"depth\":" << depth
+         << ",\"nodes\":" << stats.depth_nodes[depth]
+         << ",\"branching_factor\":" << stats.branchingFactor(depth) << '}';
+    first = false;
+  }
+  json << "]}";
+  return json.str();
+}
+
+// Adds the time of its scope to a counter with CHESS_AI_PROFILE, does nothing otherwise
+class ProfileTimer {
+public:
+  explicit ProfileTimer(std::uint64_t &total_ns) : total_ns_(total_ns) {
+    if constexpr (PROFILE) {
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  ProfileTimer(ProfileTimer const &)            = delete;
+  ProfileTimer &operator=(ProfileTimer const &) = delete;
+
+  ~ProfileTimer() {
+    if constexpr (PROFILE) {
+      total_ns_ += static_cast<std::uint64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                               start_)
+              .count());
+    }
+  }
+
+private:
+  std::uint64_t &total_ns_;
+  std::chrono::steady_clock::time_point start_;
+};
@@ -0,0 +1,380 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bot.hpp"
+#include "fen.hpp"
+#include "thread_pool.hpp"
+#include "transposition_table.hpp"
+#include "uci.hpp"
+
+// ---
+#define CHESS_NO_EXCEPTIONS
+#include <chess.hpp>
+// ---
+
+// Plays many games in one process. Every game is a session named by its client, all sessions
+// share one transposition table and a fixed number of cores. Searches wait in a queue ordered by
+// deadline and each one is given a share of the cores that are free when it starts: the earliest
+// deadline goes first and gets the largest share, as far as an idle engine has workers for it. A
+// running search keeps its cores until it ends.
+//
+// Line protocol on a pipe, every command but quit and every answer starts with the session name:
+//   <session> position startpos|fen <fen> [moves <move>...]
+//   <session> go [movetime <ms>] [wtime <ms>] [btime <ms>] [winc <ms>] [binc <ms>]
+//                [movestogo <moves>] [depth <plies>] [nodes <count>] [multipv <lines>]
+//   <session> stop
+//   <session> close
+//   quit
+// Answers, a search for more than one line first lists them from the best one down:
+//   <session> line <rank> score <cp <x>|mate <y>> pv <move>...
+//   <session> bestmove <move> score <cp <x>|mate <y>> depth <plies> nodes <count>
+//   <session> error <message>
+// Sessions are created by their first command. The deadline of a search is its movetime, or the
+// time allocated from its clock, counted from when the go command was read. Searches without
+// either only have the default limits and wait behind every search with a deadline.
+class Server {
+public:
+  Server(std::size_t hash_mb, std::size_t num_cores, SearchLimits const &defaults)
+      : defaults_(defaults), tt_(std::make_shared<TranspositionTable>(hash_mb)),
+        free_cores_(std::max<std::size_t>(num_cores, 1)), engines_(free_cores_),
+        busy_(free_cores_, false), runners_(free_cores_) {
+    scheduler_ = std::thread([this] { schedule(); });
+  }
+
+  Server(Server const &)            = delete;
+  Server &operator=(Server const &) = delete;
+
+  // Queued searches are dropped, running ones are stopped and answered
+  ~Server() {
+    {
+      std::lock_guard const lock(mutex_);
+      quit_ = true;
+      for (auto &[name, session] : sessions_) {
+        if (session.search) {
+          session.search->stop.store(true, std::memory_order_relaxed);
+        }
+      }
+      cv_.notify_all();
+    }
+    scheduler_.join();
+    for (std::size_t i = 0; i < runners_.size(); ++i) {
+      runners_.wait(i);
+    }
+  }
+
+  // Engines are created as they are needed, at most one per core. Every one is set up with the
+  // callback first, which can load the network or the book. Must be called before the first go.
+  void setupEngines(std::function<void(Bot &)> setup) { setup_ = std::move(setup); }
+
+  // Reads commands until "quit" or the end of input
+  void loop(std::istream &input) {
+    std::string line;
+    while (std::getline(input, line)) {
+      if (not handle(line)) {
+        break;
+      }
+    }
+  }
+
+  // Returns false once the server should quit
+  bool handle(std::string const &line) {
+    std::istringstream stream(line);
+    std::string name;
+    std::string command;
+    stream >> name;
+    if (name == "quit") {
+      return false;
+    }
+    if (name.empty()) {
+      return true;
+    }
+    stream >> command;
+
+    std::lock_guard const lock(mutex_);
+    auto &session = sessions_[name];
+    if (command == "position") {
+      position(name, session, stream);
+    } else if (command == "go") {
+      go(name, session, stream);
+    } else if (command == "stop") {
+      if (session.search) {
+        session.search->stop.store(true, std::memory_order_relaxed);
+      }
+    } else if (command == "close") {
+      // A running search is still answered
+      if (session.search) {
+        session.search->stop.store(true, std::memory_order_relaxed);
+      }
+      sessions_.erase(name);
+    } else {
+      send(name + " error Unknown command: " + command);
+    }
+    return true;
+  }
+
+private:
+  struct Search {
+    std::string session;
+    std::string fen;
+    std::vector<std::string> moves;
+    SearchLimits limits;
+    std::chrono::steady_clock::time_point deadline;
+    // Orders searches with the same deadline by arrival
+    std::uint64_t sequence = 0;
+    std::atomic<bool> stop{false};
+  };
+
+  struct Session {
+    std::string fen{chess::constants::STARTPOS};
+    std::vector<std::string> moves;
+    // Queued or running
+    std::shared_ptr<Search> search;
+  };
+
+  static constexpr auto NO_DEADLINE = std::chrono::steady_clock::time_point::max();
+
+  // "position startpos [moves ...]" or "position fen <fen> [moves ...]". An invalid FEN leaves
+  // the session's position as it was, the moves are checked when a search is set up.
+  void position(std::string const &name, Session &session, std::istringstream &stream) {
+    std::string token;
+    stream >> token;
+
+    std::string fen;
+    if (token == "startpos") {
+      fen = chess::constants::STARTPOS;
+      stream >> token;
+    } else if (token == "fen") {
+      while (stream >> token && token != "moves") {
+        fen += fen.empty() ? token : ' ' + token;
+      }
+    } else {
+      send(name + " error Invalid position command");
+      return;
+    }
+    if (not isValidFen(fen)) {
+      send(name + " error Invalid FEN");
+      return;
+    }
+
+    session.fen = fen;
+    session.moves.clear();
+    if (token == "moves") {
+      while (stream >> token) {
+        session.moves.push_back(token);
+      }
+    }
+  }
+
+  void go(std::string const &name, Session &session, std::istringstream &stream) {
+    if (session.search) {
+      send(name + " error Search in progress");
+      return;
+    }
+
+    auto search      = std::make_shared<Search>();
+    search->session  = name;
+    search->fen      = session.fen;
+    search->moves    = session.moves;
+    search->limits   = defaults_;
+    search->deadline = NO_DEADLINE;
+    search->sequence = next_sequence_++;
+
+    std::chrono::milliseconds white_time{};
+    std::chrono::milliseconds black_time{};
+    std::chrono::milliseconds white_increment{};
+    std::chrono::milliseconds black_increment{};
+    int moves_to_go = 0;
+    bool depth      = false;
+    bool limited    = false;
+    auto const read_ms = [&stream] {
+      long long value = 0;
+      stream >> value;
+      return std::chrono::milliseconds(std::max(value, 0LL));
+    };
+    for (std::string token; stream >> token;) {
+      if (token == "wtime") {
+        white_time = read_ms();
+      } else if (token == "btime") {
+        black_time = read_ms();
+      } else if (token == "winc") {
+        white_increment = read_ms();
+      } else if (token == "binc") {
+        black_increment = read_ms();
+      } else if (token == "movestogo") {
+        stream >> moves_to_go;
+      } else if (token == "movetime") {
+        search->limits.movetime = read_ms();
+        limited                 = true;
+      } else if (token == "depth") {
+        stream >> search->limits.depth;
+        depth = true;
+      } else if (token == "nodes") {
+        stream >> search->limits.nodes;
+        limited = true;
+      } else if (token == "multipv") {
+        stream >> search->limits.multipv;
+      }
+    }
+
+    // Only the FEN tells whose clock counts, the moves flip it once for every one of them. The
+    // side to move is its second field, which position() checked.
+    bool white = search->fen.substr(search->fen.find(' ') + 1, 1) == "w";
+    white      = white == (search->moves.size() % 2 == 0);
+    auto const time      = white ? white_time : black_time;
+    auto const increment = white ? white_increment : black_increment;
+    if (time.count() != 0) {
+      search->limits.movetime = allocateTime(time, increment, moves_to_go);
+      limited                 = true;
+    }
+    if (limited && not depth) {
+      search->limits.depth = MAX_PLY - 1;
+    }
+    if (search->limits.movetime.count() != 0) {
+      search->deadline = std::chrono::steady_clock::now() + search->limits.movetime;
+    }
+
+    session.search = search;
+    queue_.push_back(std::move(search));
+    cv_.notify_all();
+  }
+
+  // Hands queued searches to idle runners while there are free cores
+  void schedule() {
+    std::unique_lock lock(mutex_);
+    while (true) {
+      cv_.wait(lock, [this] { return quit_ || (not queue_.empty() && free_cores_ > 0); });
+      if (quit_) {
+        return;
+      }
+
+      auto const next = std::min_element(
+          queue_.begin(), queue_.end(), [](auto const &a, auto const &b) {
+            return a->deadline != b->deadline ? a->deadline < b->deadline
+                                              : a->sequence < b->sequence;
+          });
+      auto search = *next;
+      queue_.erase(next);
+      // Rounded up, so the earlier deadlines get the larger shares
+      auto threads = (free_cores_ + queue_.size()) / (queue_.size() + 1);
+      // A runner is busy for as long as its search holds cores, so one is idle. The share goes to
+      // the smallest idle engine that can take it, or is cut down to the largest idle one.
+      auto runner = busy_.size();
+      for (std::size_t i = busy_.size(); i-- > 0;) {
+        if (not busy_[i]) {
+          runner = i;
+          if (engineThreads(i) >= threads) {
+            break;
+          }
+        }
+      }
+      threads = std::min(threads, engineThreads(runner));
+      free_cores_ -= threads;
+      busy_[runner] = true;
+      lock.unlock();
+
+      // The runner may still be returning from its last search
+      runners_.wait(runner);
+      if (not engines_[runner]) {
+        engines_[runner] = std::make_unique<Bot>(tt_, engineThreads(runner));
+        if (setup_) {
+          setup_(*engines_[runner]);
+        }
+      }
+      runners_.submit(runner, [this, runner, search, threads] { run(runner, *search, threads); });
+      lock.lock();
+    }
+  }
+
+  // Engine i is only used while at least i other searches hold cores, so it gets the share of the
+  // cores i + 1 searches would have. Larger shares are cut down to it, and all engines together
+  // have about cores * ln(cores) workers instead of cores^2.
+  [[nodiscard]] std::size_t engineThreads(std::size_t runner) const {
+    return std::max<std::size_t>(engines_.size() / (runner + 1), 1);
+  }
+
+  void run(std::size_t runner, Search &search, std::size_t threads) {
+    auto &engine = *engines_[runner];
+    std::string answer;
+    if (engine.setPosition(search.fen, search.moves)) {
+      auto limits    = search.limits;
+      limits.threads = threads;
+      limits.stop    = &search.stop;
+      // Time spent in the queue counts against the deadline
+      if (search.deadline != NO_DEADLINE) {
+        limits.movetime = std::max(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                       search.deadline - std::chrono::steady_clock::now()),
+                                   std::chrono::milliseconds(1));
+      }
+      auto const result = engine.findBestMove(limits);
+      if (result.lines.size() > 1) {
+        for (std::size_t i = 0; i < result.lines.size(); ++i) {
+          answer += search.session + " line " + std::to_string(i + 1) + " score " +
+                    uciScore(result.lines[i].eval) + " pv";
+          for (auto const &move : result.lines[i].pv) {
+            answer += ' ' + chess::uci::moveToUci(move);
+          }
+          answer += '\n';
+        }
+      }
+      // Checkmate or stalemate at the root
+      auto const move = result.move == chess::Move::NO_MOVE ? std::string("0000")
+                                                            : chess::uci::moveToUci(result.move);
+      answer += search.session + " bestmove " + move + " score " + uciScore(result.eval) +
+                " depth " + std::to_string(result.depth) + " nodes " +
+                std::to_string(result.nodes);
+    } else {
+      answer = search.session + " error Illegal move";
+    }
+
+    std::lock_guard const lock(mutex_);
+    send(answer);
+    auto const session = sessions_.find(search.session);
+    if (session != sessions_.end() && session->second.search.get() == &search) {
+      session->second.search.reset();
+    }
+    free_cores_ += threads;
+    busy_[runner] = false;
+    cv_.notify_all();
+  }
+
+  void send(std::string const &message) {
+    std::lock_guard const lock(output_mutex_);
+    std::cout << message << std::endl;
+  }
+
+  SearchLimits const defaults_;
+  std::shared_ptr<TranspositionTable> const tt_;
+  std::function<void(Bot &)> setup_;
+
+  // Guards everything below up to the engines, which only the scheduler and their runner touch
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::map<std::string, Session> sessions_;
+  std::vector<std::shared_ptr<Search>> queue_;
+  std::uint64_t next_sequence_ = 0;
+  std::size_t free_cores_;
+  bool quit_ = false;
+
+  std::mutex output_mutex_;
+
+  // Engine i is only used by runner i and has engineThreads(i) workers, a search uses as many of
+  // them as it was given cores.
+  std::vector<std::unique_ptr<Bot>> engines_;
+  std::vector<bool> busy_;
+  // Declared last so its workers are joined before anything they use is destroyed
+  ThreadPool runners_;
+  std::thread scheduler_;
+};
@@ -0,0 +1,166 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#ifdef CHESS_AI_USE_SYZYGY
+#include <tbprobe.h>
+#endif
+
+// ---
+#define CHESS_NO_EXCEPTIONS
+#include <chess.hpp>
+// ---
+
+// Syzygy endgame tablebases through Fathom, built in with -DCHESS_AI_USE_SYZYGY=ON. Without it
+// every probe fails and the search never notices the tablebases are missing.
+#ifdef CHESS_AI_USE_SYZYGY
+constexpr bool SYZYGY_AVAILABLE = true;
+#else
+constexpr bool SYZYGY_AVAILABLE = false;
+#endif
+
+// Score of a tablebase win, far above any evaluation but below the mate scores, minus the ply so
+// that the search still heads for the win
+constexpr auto TB_WIN_SCORE = 20000;
+// Tablebase probes in the search are limited to this many pieces unless configured otherwise
+constexpr auto SYZYGY_DEFAULT_PROBE_LIMIT = 7;
+
+// Win, draw or loss for the side to move. The cursed win and blessed loss are draws under the
+// fifty-move rule and are reported as such.
+enum class Wdl : std::int8_t { LOSS = -1, DRAW = 0, WIN = 1 };
+
+// Loads the tablebases in the directories of the path, separated by ':' (';' on Windows). Not
+// thread-safe, must not be called while a search is running. Returns false if none were found.
+inline bool initSyzygy(std::string const &path) {
+#ifdef CHESS_AI_USE_SYZYGY
+  return tb_init(path.c_str()) && TB_LARGEST > 0;
+#else
+  static_cast<void>(path);
+  return false;
+#endif
+}
+
+// Largest number of pieces, kings included, the loaded tablebases cover
+[[nodiscard]] inline int syzygyPieces() {
+#ifdef CHESS_AI_USE_SYZYGY
+  return static_cast<int>(TB_LARGEST);
+#else
+  return 0;
+#endif
+}
+
+#ifdef CHESS_AI_USE_SYZYGY
+namespace detail {
+
+// Fathom takes the position as bitboards by color and piece type
+struct FathomPosition {
+  std::uint64_t white, black, kings, queens, rooks, bishops, knights, pawns;
+  unsigned ep;
+  bool white_to_move;
+};
+
+[[nodiscard]] inline FathomPosition fathomPosition(chess::Board const &board) {
+  using chess::Color;
+  using chess::PieceType;
+  auto const ep = board.enpassantSq();
+  return {board.us(Color::WHITE).getBits(),
+          board.us(Color::BLACK).getBits(),
+          board.pieces(PieceType::KING).getBits(),
+          board.pieces(PieceType::QUEEN).getBits(),
+          board.pieces(PieceType::ROOK).getBits(),
+          board.pieces(PieceType::BISHOP).getBits(),
+          board.pieces(PieceType::KNIGHT).getBits(),
+          board.pieces(PieceType::PAWN).getBits(),
+          ep == chess::Square::underlying::NO_SQ ? 0U : static_cast<unsigned>(ep.index()),
+          board.sideToMove() == Color::WHITE};
+}
+
+[[nodiscard]] inline Wdl toWdl(unsigned wdl) {
+  return wdl == TB_WIN ? Wdl::WIN : wdl == TB_LOSS ? Wdl::LOSS : Wdl::DRAW;
+}
+
+} // namespace detail
+#endif
+
+// Thread-safe. Only succeeds in positions without castling rights whose fifty-move counter was
+// just reset, which in a search is right after every capture and pawn move.
+[[nodiscard]] inline bool probeWdl(chess::Board const &board, Wdl &wdl) {
+#ifdef CHESS_AI_USE_SYZYGY
+  if (board.occ().count() > syzygyPieces() || board.halfMoveClock() != 0 ||
+      not board.castlingRights().isEmpty()) {
+    return false;
+  }
+  auto const p      = detail::fathomPosition(board);
+  auto const result = tb_probe_wdl(p.white, p.black, p.kings, p.queens, p.rooks, p.bishops,
+                                   p.knights, p.pawns, 0, 0, p.ep, p.white_to_move);
+  if (result == TB_RESULT_FAILED) {
+    return false;
+  }
+  wdl = detail::toWdl(result);
+  return true;
+#else
+  static_cast<void>(board);
+  static_cast<void>(wdl);
+  return false;
+#endif
+}
+
+// Picks the move that keeps the best result and makes the most progress towards it under the
+// fifty-move rule. Returns chess::Move::NO_MOVE if the position isn't in the tablebases.
+[[nodiscard]] inline chess::Move probeRoot(chess::Board const &board, Wdl &wdl) {
+#ifdef CHESS_AI_USE_SYZYGY
+  if (board.occ().count() > syzygyPieces() || not board.castlingRights().isEmpty()) {
+    return chess::Move::NO_MOVE;
+  }
+
+  // Fathom's root probe keeps state of its own, so concurrent searches take turns
+  static std::mutex mutex;
+  auto const p = detail::fathomPosition(board);
+  unsigned result;
+  {
+    std::lock_guard const lock(mutex);
+    result = tb_probe_root(p.white, p.black, p.kings, p.queens, p.rooks, p.bishops, p.knights,
+                           p.pawns, board.halfMoveClock(), 0, p.ep, p.white_to_move, nullptr);
+  }
+  if (result == TB_RESULT_FAILED || result == TB_RESULT_CHECKMATE ||
+      result == TB_RESULT_STALEMATE) {
+    return chess::Move::NO_MOVE;
+  }
+
+  // Fathom numbers promotions from the queen down
+  constexpr chess::PieceType::underlying PROMOTIONS[] = {
+      chess::PieceType::NONE, chess::PieceType::QUEEN, chess::PieceType::ROOK,
+      chess::PieceType::BISHOP, chess::PieceType::KNIGHT};
+  auto const from      = static_cast<int>(TB_GET_FROM(result));
+  auto const to        = static_cast<int>(TB_GET_TO(result));
+  auto const promotion = PROMOTIONS[TB_GET_PROMOTES(result)];
+
+  chess::Movelist moves;
+  chess::movegen::legalmoves(moves, board);
+  for (auto const &move : moves) {
+    if (move.from().index() == from && move.to().index() == to &&
+        (move.typeOf() != chess::Move::PROMOTION || move.promotionType() == promotion)) {
+      wdl = detail::toWdl(TB_GET_WDL(result));
+      return move;
+    }
+  }
+  return chess::Move::NO_MOVE;
+#else
+  static_cast<void>(board);
+  static_cast<void>(wdl);
+  return chess::Move::NO_MOVE;
+#endif
+}
+
+// Tablebase result as a search score from the point of view of the side to move
+[[nodiscard]] inline constexpr int wdlScore(Wdl wdl, int ply) {
+  switch (wdl) {
+  case Wdl::WIN:
+    return TB_WIN_SCORE - ply;
+  case Wdl::LOSS:
+    return -TB_WIN_SCORE + ply;
+  default:
+    return 0;
+  }
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+[[nodiscard]] inline std::size_t defaultThreadCount() {
+  return std::max(1U, std::thread::hardware_concurrency());
+}
+
+// Fixed set of long-lived worker threads. Every worker has its own task slot, so callers address
+// workers by index and can keep per-worker state (boards, search stacks) in a parallel array.
+class ThreadPool {
+public:
+  explicit ThreadPool(std::size_t num_threads = defaultThreadCount()) { start(num_threads); }
+
+  ThreadPool(ThreadPool const &)            = delete;
+  ThreadPool &operator=(ThreadPool const &) = delete;
+
+  ~ThreadPool() { join(); }
+
+  [[nodiscard]] std::size_t size() const { return workers_.size(); }
+
+  // Replaces the workers. All of them must be idle.
+  void resize(std::size_t num_threads) {
+    join();
+    start(num_threads);
+  }
+
+  // Hands a task to an idle worker. The worker must have been waited for since its last task.
+  void submit(std::size_t index, std::function<void()> task) {
+    auto &worker = *workers_[index];
+    {
+      std::lock_guard const lock(worker.mutex);
+      worker.task = std::move(task);
+      worker.busy = true;
+    }
+    worker.cv.notify_all();
+  }
+
+  // Blocks until the worker has finished its current task.
+  void wait(std::size_t index) {
+    auto &worker = *workers_[index];
+    std::unique_lock lock(worker.mutex);
+    worker.cv.wait(lock, [&worker] { return not worker.busy; });
+  }
+
+  // Runs task(i) on worker i for every i in [0, count) and blocks until all of them are done.
+  void run(std::size_t count, std::function<void(std::size_t)> const &task) {
+    count = std::min(count, size());
+    for (std::size_t i = 0; i < count; ++i) {
+      submit(i, [&task, i] { task(i); });
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+      wait(i);
+    }
+  }
+
+private:
+  struct Worker {
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::function<void()> task;
+    bool busy = false;
+    bool quit = false;
+  };
+
+  void start(std::size_t num_threads) {
+    for (std::size_t i = 0; i < std::max<std::size_t>(num_threads, 1); ++i) {
+      workers_.push_back(std::make_unique<Worker>());
+    }
+    for (auto &worker : workers_) {
+      worker->thread = std::thread([&worker = *worker] { loop(worker); });
+    }
+  }
+
+  void join() {
+    for (auto &worker : workers_) {
+      {
+        std::lock_guard const lock(worker->mutex);
+        worker->quit = true;
+      }
+      worker->cv.notify_all();
+    }
+    for (auto &worker : workers_) {
+      worker->thread.join();
+    }
+    workers_.clear();
+  }
+
+  static void loop(Worker &worker) {
+    while (true) {
+      std::unique_lock lock(worker.mutex);
+      worker.cv.wait(lock, [&worker] { return worker.busy or worker.quit; });
+      if (not worker.busy) {
+        return;
+      }
+
+      auto task = std::move(worker.task);
+      lock.unlock();
+      task();
+      lock.lock();
+
+      worker.busy = false;
+      lock.unlock();
+      worker.cv.notify_all();
+    }
+  }
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+};
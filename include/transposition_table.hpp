@@ -0,0 +1,122 @@
+#pragma once
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+
+// ---
+#define CHESS_NO_EXCEPTIONS
+#include <chess.hpp>
+// ---
+
+constexpr std::size_t DEFAULT_HASH_MB = 64;
+// Entries remember the search that stored them modulo this, searches of several games sharing a
+// table count as well
+constexpr unsigned TT_GENERATIONS = 64;
+// An entry of the current generation is only replaced by another position searched at most this
+// much shallower. Entries of earlier searches are always replaced.
+constexpr int TT_REPLACE_MARGIN = 2;
+
+enum class Bound : std::uint8_t { NONE, EXACT, LOWER, UPPER };
+
+struct TTEntry {
+  chess::Move move{chess::Move::NO_MOVE};
+  int score           = 0;
+  int depth           = 0;
+  Bound bound         = Bound::NONE;
+  unsigned generation = 0;
+};
+
+// Fixed-size hash table shared by all search threads. Every slot holds two 64-bit words: the
+// packed data and the position key XOR-ed with that data. A torn write from two racing threads
+// then fails the key check on probe instead of handing back a mix of two entries, so no locking
+// is needed.
+class TranspositionTable {
+public:
+  explicit TranspositionTable(std::size_t megabytes = DEFAULT_HASH_MB) { resize(megabytes); }
+
+  // Not thread-safe, must not be called while a search is running.
+  void resize(std::size_t megabytes) {
+    auto const bytes = std::max<std::size_t>(megabytes, 1) * 1024 * 1024;
+    auto const count = std::bit_floor(bytes / sizeof(Slot));
+    slots_           = std::make_unique<Slot[]>(count);
+    mask_            = count - 1;
+    clear();
+  }
+
+  // Called once per search. Thread-safe, searches of several games may share the table.
+  void newSearch() { generation_.fetch_add(1, std::memory_order_relaxed); }
+
+  // Not thread-safe, must not be called while a search is running.
+  void clear() {
+    for (std::size_t i = 0; i <= mask_; ++i) {
+      slots_[i].key.store(0, std::memory_order_relaxed);
+      slots_[i].data.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  [[nodiscard]] bool probe(std::uint64_t key, TTEntry &entry) const {
+    auto const &slot = slots_[key & mask_];
+    auto const data  = slot.data.load(std::memory_order_relaxed);
+    if ((slot.key.load(std::memory_order_relaxed) ^ data) != key || data == 0) {
+      return false;
+    }
+    entry = unpack(data);
+    return true;
+  }
+
+  void store(std::uint64_t key, int depth, Bound bound, int score, chess::Move move) {
+    auto &slot            = slots_[key & mask_];
+    auto const old_data   = slot.data.load(std::memory_order_relaxed);
+    bool const same_key   = (slot.key.load(std::memory_order_relaxed) ^ old_data) == key;
+    auto const old_entry  = unpack(old_data);
+    auto const generation = generation_.load(std::memory_order_relaxed) % TT_GENERATIONS;
+
+    // Keep the deeper result for the same position unless the new one is exact
+    if (same_key && old_data != 0 && depth < old_entry.depth && bound != Bound::EXACT) {
+      return;
+    }
+    // Keep a much deeper result of the current search for another position
+    if (not same_key && old_data != 0 && old_entry.generation == generation &&
+        depth + TT_REPLACE_MARGIN < old_entry.depth) {
+      return;
+    }
+    // Don't lose the best move of a position just because this visit didn't find one
+    if (same_key && move == chess::Move::NO_MOVE) {
+      move = old_entry.move;
+    }
+
+    auto const data = pack(depth, bound, generation, score, move);
+    slot.key.store(key ^ data, std::memory_order_relaxed);
+    slot.data.store(data, std::memory_order_relaxed);
+  }
+
+private:
+  struct Slot {
+    std::atomic<std::uint64_t> key{0};
+    std::atomic<std::uint64_t> data{0};
+  };
+
+  // Layout: score (32) | move (16) | depth (8) | bound (2) | generation (6)
+  [[nodiscard]] static std::uint64_t pack(int depth, Bound bound, unsigned generation, int score,
+                                          chess::Move move) {
+    return static_cast<std::uint64_t>(static_cast<std::uint32_t>(score)) |
+           (static_cast<std::uint64_t>(move.move()) << 32) |
+           (static_cast<std::uint64_t>(static_cast<std::uint8_t>(depth)) << 48) |
+           (static_cast<std::uint64_t>(bound) << 56) | (std::uint64_t{generation} << 58);
+  }
+
+  [[nodiscard]] static TTEntry unpack(std::uint64_t data) {
+    TTEntry entry;
+    entry.score      = static_cast<int>(static_cast<std::uint32_t>(data & 0xFFFFFFFF));
+    entry.move       = chess::Move(static_cast<std::uint16_t>((data >> 32) & 0xFFFF));
+    entry.depth      = static_cast<int>((data >> 48) & 0xFF);
+    entry.bound      = static_cast<Bound>((data >> 56) & 0x3);
+    entry.generation = static_cast<unsigned>(data >> 58);
+    return entry;
+  }
+
+  std::unique_ptr<Slot[]> slots_;
+  std::uint64_t mask_ = 0;
+  std::atomic<unsigned> generation_{0};
+};
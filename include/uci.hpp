@@ -0,0 +1,442 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bot.hpp"
+#include "fen.hpp"
+
+// ---
+#define CHESS_NO_EXCEPTIONS
+#include <chess.hpp>
+// ---
+
+// Moves expected until the next time control when the GUI doesn't say
+constexpr auto UCI_DEFAULT_MOVES_TO_GO = 30;
+// Kept in reserve for communication and scheduling delays
+constexpr std::chrono::milliseconds UCI_MOVE_OVERHEAD{30};
+
+// Splits the remaining clock time evenly over the moves left until the next time control
+[[nodiscard]] inline std::chrono::milliseconds allocateTime(std::chrono::milliseconds time,
+                                                            std::chrono::milliseconds increment,
+                                                            int moves_to_go) {
+  auto const moves  = moves_to_go > 0 ? moves_to_go : UCI_DEFAULT_MOVES_TO_GO;
+  auto const budget = time / moves + increment * 3 / 4;
+  return std::clamp(budget, std::chrono::milliseconds(1),
+                    std::max(time - UCI_MOVE_OVERHEAD, std::chrono::milliseconds(1)));
+}
+
+// Score in UCI notation, mate scores as moves to mate
+[[nodiscard]] inline std::string uciScore(int score) {
+  if (std::abs(score) > MATE_BOUND) {
+    auto const plies = MATE_SCORE - std::abs(score);
+    auto const moves = (plies + 1) / 2;
+    return "mate " + std::to_string(score > 0 ? moves : -moves);
+  }
+  return "cp " + std::to_string(score);
+}
+
+// Universal Chess Interface frontend. Searches run on their own thread so that stop, ponderhit and
+// isready are answered while thinking.
+class Uci {
+public:
+  // The defaults apply to a bare "go" and to searches of plain FEN lines
+  Uci(Bot &bot, SearchLimits const &defaults) : bot_(bot), defaults_(defaults) {
+    bot_.onIteration([this](SearchInfo const &info) { sendInfo(info); });
+  }
+
+  Uci(Uci const &)            = delete;
+  Uci &operator=(Uci const &) = delete;
+
+  ~Uci() {
+    stopSearch();
+    bot_.onIteration(nullptr);
+  }
+
+  // Clients sending plain FEN lines don't know about pondering. With it on, the position after the
+  // expected reply is searched until their next line, which is answered from that search if the
+  // reply was played.
+  void setLegacyPonder(bool ponder) { legacy_ponder_ = ponder; }
+
+  // Reads commands until "quit" or the end of input
+  void loop(std::istream &input) {
+    std::string line;
+    while (std::getline(input, line)) {
+      if (not handle(line)) {
+        break;
+      }
+    }
+  }
+
+  // Returns false once the engine should quit
+  bool handle(std::string const &line) {
+    std::istringstream stream(line);
+    std::string command;
+    stream >> command;
+
+    if (command == "quit") {
+      stopSearch();
+      return false;
+    }
+    if (command == "uci") {
+      send("id name chess-ai");
+      send("id author robertmrk1");
+      send("option name Hash type spin default " + std::to_string(DEFAULT_HASH_MB) +
+           " min 1 max 65536");
+      send("option name Threads type spin default " + std::to_string(bot_.threadCount()) +
+           " min 1 max 1024");
+      send("option name EvalFile type string default <empty>");
+      send("option name BookFile type string default <empty>");
+      send("option name Ponder type check default false");
+      send("option name MultiPV type spin default " + std::to_string(defaults_.multipv) +
+           " min 1 max " + std::to_string(chess::constants::MAX_MOVES));
+      send("option name Seed type spin default 0 min 0 max 2147483647");
+      if constexpr (SYZYGY_AVAILABLE) {
+        send("option name SyzygyPath type string default <empty>");
+        send("option name SyzygyProbeLimit type spin default " +
+             std::to_string(SYZYGY_DEFAULT_PROBE_LIMIT) + " min 0 max 7");
+      }
+      send("uciok");
+    } else if (command == "isready") {
+      send("readyok");
+    } else if (command == "stop") {
+      stopSearch();
+    } else if (command == "ponderhit") {
+      std::lock_guard const lock(mutex_);
+      ponder_.store(false, std::memory_order_relaxed);
+      cv_.notify_all();
+    } else if (command == "ucinewgame") {
+      waitForSearch();
+      bot_.newGame();
+    } else if (command == "position") {
+      waitForSearch();
+      position(stream);
+    } else if (command == "setoption") {
+      waitForSearch();
+      setOption(stream);
+    } else if (command == "go") {
+      waitForSearch();
+      go(stream);
+    } else if (line.find('/') != std::string::npos) {
+      legacySearch(line);
+    } else if (not command.empty()) {
+      send("info string Unknown command: " + line);
+    }
+    return true;
+  }
+
+private:
+  // "position startpos [moves ...]" or "position fen <fen> [moves ...]"
+  void position(std::istringstream &stream) {
+    std::string token;
+    stream >> token;
+
+    std::string fen;
+    if (token == "startpos") {
+      fen = chess::constants::STARTPOS;
+      stream >> token;
+    } else if (token == "fen") {
+      while (stream >> token && token != "moves") {
+        fen += fen.empty() ? token : ' ' + token;
+      }
+    } else {
+      send("info string Invalid position command");
+      return;
+    }
+
+    if (not isValidFen(fen)) {
+      send("info string Invalid FEN, position unchanged");
+      return;
+    }
+
+    std::vector<std::string> moves;
+    if (token == "moves") {
+      while (stream >> token) {
+        moves.push_back(token);
+      }
+    }
+    if (not bot_.setPosition(fen, moves)) {
+      send("info string Illegal move, position set up to the last legal one");
+    }
+  }
+
+  // "setoption name <name> value <value>"
+  void setOption(std::istringstream &stream) {
+    std::string token;
+    std::string name;
+    std::string value;
+    stream >> token;
+    while (stream >> token && token != "value") {
+      name += name.empty() ? token : ' ' + token;
+    }
+    std::getline(stream >> std::ws, value);
+
+    if (name == "Hash") {
+      bot_.setHashSize(std::max(std::strtoull(value.c_str(), nullptr, 10), 1ULL));
+    } else if (name == "Threads") {
+      bot_.setThreadCount(std::max(std::strtoull(value.c_str(), nullptr, 10), 1ULL));
+    } else if (name == "EvalFile") {
+      if (not bot_.loadNetwork(value)) {
+        send("info string Could not load network " + value);
+      }
+    } else if (name == "BookFile") {
+      if (not bot_.loadBook(value == "<empty>" ? std::string() : value)) {
+        send("info string Could not open book " + value);
+      }
+    } else if (name == "SyzygyPath") {
+      if (value != "<empty>" && not initSyzygy(value)) {
+        send("info string No tablebases found in " + value);
+      }
+    } else if (name == "Seed") {
+      // 0 switches deterministic searches off
+      auto const seed = std::strtoull(value.c_str(), nullptr, 10);
+      bot_.setSeed(seed == 0 ? std::nullopt : std::optional<std::uint64_t>(seed));
+    } else if (name == "MultiPV") {
+      defaults_.multipv = std::max(std::strtoull(value.c_str(), nullptr, 10), 1ULL);
+    } else if (name == "SyzygyProbeLimit") {
+      bot_.setSyzygyProbeLimit(std::atoi(value.c_str()));
+    } else if (name != "Ponder") {
+      send("info string Unknown option: " + name);
+    }
+  }
+
+  void go(std::istringstream &stream) {
+    auto limits = defaults_;
+    std::chrono::milliseconds white_time{};
+    std::chrono::milliseconds black_time{};
+    std::chrono::milliseconds white_increment{};
+    std::chrono::milliseconds black_increment{};
+    int moves_to_go = 0;
+    bool infinite   = false;
+    bool ponder     = false;
+    bool depth      = false;
+    bool limited    = false;
+
+    auto const read_ms = [&stream] {
+      long long value = 0;
+      stream >> value;
+      return std::chrono::milliseconds(std::max(value, 0LL));
+    };
+    for (std::string token; stream >> token;) {
+      if (token == "wtime") {
+        white_time = read_ms();
+      } else if (token == "btime") {
+        black_time = read_ms();
+      } else if (token == "winc") {
+        white_increment = read_ms();
+      } else if (token == "binc") {
+        black_increment = read_ms();
+      } else if (token == "movestogo") {
+        stream >> moves_to_go;
+      } else if (token == "movetime") {
+        limits.movetime = read_ms();
+        limited         = true;
+      } else if (token == "depth") {
+        stream >> limits.depth;
+        depth = true;
+      } else if (token == "nodes") {
+        stream >> limits.nodes;
+        limited = true;
+      } else if (token == "infinite") {
+        infinite = true;
+      } else if (token == "ponder") {
+        ponder = true;
+      }
+    }
+
+    bool const white     = bot_.board().sideToMove() == chess::Color::WHITE;
+    auto const time      = white ? white_time : black_time;
+    auto const increment = white ? white_increment : black_increment;
+    if (time.count() != 0) {
+      limits.movetime = allocateTime(time, increment, moves_to_go);
+      limited         = true;
+    }
+    if (infinite) {
+      limits.movetime = {};
+      limits.nodes    = 0;
+      limited         = true;
+    }
+    // The default depth only applies when the GUI sets no limit of its own
+    if ((limited || ponder) && not depth) {
+      limits.depth = MAX_PLY - 1;
+    }
+
+    startSearch(limits, ponder, infinite, false);
+  }
+
+  // Legacy input: a FEN searched on its own, answered with just the move
+  void legacySearch(std::string const &fen) {
+    if (not isValidFen(fen)) {
+      waitForSearch();
+      send("info string Invalid FEN");
+      return;
+    }
+    if (legacy_ponder_key_ && *legacy_ponder_key_ == chess::Board(fen).hash()) {
+      // Ponder hit, the search carries on as the real one and answers when done
+      legacy_ponder_key_.reset();
+      {
+        std::lock_guard const lock(mutex_);
+        ponder_.store(false, std::memory_order_relaxed);
+        cv_.notify_all();
+      }
+      search_.join();
+    } else {
+      waitForSearch();
+      bot_.setPosition(fen);
+      startSearch(defaults_, false, false, true);
+      search_.join();
+    }
+    if (not legacy_ponder_) {
+      return;
+    }
+
+    chess::Move move;
+    chess::Move reply;
+    {
+      std::lock_guard const lock(output_mutex_);
+      if (last_pv_.size() < 2 || last_pv_[0] != last_move_) {
+        return;
+      }
+      move  = last_pv_[0];
+      reply = last_pv_[1];
+    }
+    if (bot_.makeMove(chess::uci::moveToUci(move)) &&
+        bot_.makeMove(chess::uci::moveToUci(reply))) {
+      legacy_ponder_key_ = bot_.board().hash();
+      startSearch(defaults_, true, false, true);
+    }
+  }
+
+  // Searches the current position on a thread of its own. Legacy searches answer with just the
+  // move and show no info.
+  void startSearch(SearchLimits limits, bool ponder, bool infinite, bool legacy) {
+    stop_.store(false, std::memory_order_relaxed);
+    ponder_.store(ponder, std::memory_order_relaxed);
+    infinite_     = infinite;
+    discard_      = false;
+    send_info_    = not legacy;
+    limits.stop   = &stop_;
+    limits.ponder = &ponder_;
+    {
+      std::lock_guard const lock(output_mutex_);
+      last_pv_.clear();
+    }
+
+    search_ = std::thread([this, limits, legacy] {
+      auto const result = bot_.findBestMove(limits);
+      // The GUI expects no bestmove before it ends an infinite or ponder search
+      {
+        std::unique_lock lock(mutex_);
+        cv_.wait(lock, [this] {
+          return stop_.load(std::memory_order_relaxed) ||
+                 not(infinite_ || ponder_.load(std::memory_order_relaxed));
+        });
+        if (discard_) {
+          return;
+        }
+      }
+
+      // Checkmate or stalemate at the root
+      auto message = result.move == chess::Move::NO_MOVE ? std::string("0000")
+                                                         : chess::uci::moveToUci(result.move);
+      std::lock_guard const lock(output_mutex_);
+      last_move_ = result.move;
+      if (not legacy) {
+        message = "bestmove " + message;
+        if (last_pv_.size() > 1 && last_pv_[0] == result.move) {
+          message += " ponder " + chess::uci::moveToUci(last_pv_[1]);
+        }
+      }
+      std::cout << message << std::endl;
+    });
+  }
+
+  // The principal variation of the best line is kept even when not shown, legacy pondering
+  // follows it
+  void sendInfo(SearchInfo const &info) {
+    if (not send_info_) {
+      if (info.multipv == 1) {
+        std::lock_guard const lock(output_mutex_);
+        last_pv_ = info.pv;
+      }
+      return;
+    }
+    auto const ms = std::max<std::int64_t>(info.time.count(), 1);
+    auto message  = "info depth " + std::to_string(info.depth) + " multipv " +
+                   std::to_string(info.multipv) + " score " + uciScore(info.score) + " nodes " +
+                   std::to_string(info.nodes) + " nps " + std::to_string(info.nodes * 1000 / ms) +
+                   " time " + std::to_string(info.time.count()) + " pv";
+    for (auto const &move : info.pv) {
+      message += ' ' + chess::uci::moveToUci(move);
+    }
+    std::lock_guard const lock(output_mutex_);
+    if (info.multipv == 1) {
+      last_pv_ = info.pv;
+    }
+    std::cout << message << std::endl;
+  }
+
+  void send(std::string const &message) {
+    std::lock_guard const lock(output_mutex_);
+    std::cout << message << std::endl;
+  }
+
+  void stopSearch() {
+    abandonLegacyPonder();
+    {
+      std::lock_guard const lock(mutex_);
+      stop_.store(true, std::memory_order_relaxed);
+      cv_.notify_all();
+    }
+    waitForSearch();
+  }
+
+  void waitForSearch() {
+    abandonLegacyPonder();
+    if (search_.joinable()) {
+      search_.join();
+    }
+  }
+
+  // A legacy ponder search that wasn't hit is stopped without an answer
+  void abandonLegacyPonder() {
+    if (not legacy_ponder_key_) {
+      return;
+    }
+    legacy_ponder_key_.reset();
+    std::lock_guard const lock(mutex_);
+    discard_ = true;
+    stop_.store(true, std::memory_order_relaxed);
+    cv_.notify_all();
+  }
+
+  Bot &bot_;
+  SearchLimits defaults_;
+
+  std::thread search_;
+  std::atomic<bool> stop_{false};
+  std::atomic<bool> ponder_{false};
+  bool infinite_      = false;
+  bool send_info_     = false;
+  bool legacy_ponder_ = false;
+  // Hash of the position a legacy ponder search is running on
+  std::optional<std::uint64_t> legacy_ponder_key_;
+  // Guards the wait for stop or ponderhit at the end of a search, and the discard flag
+  std::mutex mutex_;
+  bool discard_ = false;
+  std::condition_variable cv_;
+
+  // Guards standard output, the principal variation of the last iteration and the last answer
+  std::mutex output_mutex_;
+  chess::Movelist last_pv_;
+  chess::Move last_move_ = chess::Move::NO_MOVE;
+};
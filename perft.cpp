@@ -0,0 +1,230 @@
+// Move generator node counts and microbenchmarks:
+//   perft [--divide] <depth> [fen]
+//   perft --verify
+//   perft --bench
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// ---
+#define CHESS_NO_EXCEPTIONS
+#include <chess.hpp>
+// ---
+
+namespace {
+
+struct PerftPosition {
+  std::string_view name;
+  std::string_view fen;
+  // Known node counts from depth 1 on
+  std::vector<std::uint64_t> nodes;
+};
+
+// https://www.chessprogramming.org/Perft_Results
+std::vector<PerftPosition> const POSITIONS = {
+    {"start", chess::constants::STARTPOS, {20, 400, 8902, 197281, 4865609, 119060324}},
+    {"kiwipete",
+     "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+     {48, 2039, 97862, 4085603, 193690690}},
+    {"position 3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+     {14, 191, 2812, 43238, 674624, 11030083}},
+    {"position 4",
+     "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+     {6, 264, 9467, 422333, 15833292}},
+    {"position 5",
+     "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+     {44, 1486, 62379, 2103487, 89941194}},
+    {"position 6",
+     "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+     {46, 2079, 89890, 3894594, 164075551}},
+};
+
+// A benchmark runs until it has taken at least this long
+constexpr std::chrono::milliseconds MIN_BENCH_TIME{500};
+
+// Leaves are counted from the number of legal moves of their parent instead of making them
+std::uint64_t perft(chess::Board &board, int depth) {
+  if (depth == 0) {
+    return 1;
+  }
+  chess::Movelist moves;
+  chess::movegen::legalmoves(moves, board);
+  if (depth == 1) {
+    return static_cast<std::uint64_t>(moves.size());
+  }
+  std::uint64_t nodes = 0;
+  for (auto const &move : moves) {
+    board.makeMove(move);
+    nodes += perft(board, depth - 1);
+    board.unmakeMove(move);
+  }
+  return nodes;
+}
+
+// Nodes per root move, then the total
+std::uint64_t divide(chess::Board &board, int depth) {
+  chess::Movelist moves;
+  chess::movegen::legalmoves(moves, board);
+  std::uint64_t total = 0;
+  for (auto const &move : moves) {
+    board.makeMove(move);
+    auto const nodes = perft(board, depth - 1);
+    board.unmakeMove(move);
+    std::cout << chess::uci::moveToUci(move) << ": " << nodes << '\n';
+    total += nodes;
+  }
+  return total;
+}
+
+[[nodiscard]] double seconds(std::chrono::steady_clock::duration time) {
+  return std::chrono::duration<double>(time).count();
+}
+
+// Keeps the compiler from dropping or hoisting the computation of a value that is never used
+template <class T>
+void doNotOptimize(T const &value) {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "r,m"(value) : "memory");
+#else
+  static T const *volatile sink;
+  sink = &value;
+#endif
+}
+
+// Calls the body with batches of doubling size until a batch takes long enough to time. Every
+// call does operations operations, returns the time per operation in nanoseconds.
+template <class Body>
+double nanosecondsPerOperation(std::uint64_t operations, Body &&body) {
+  for (std::uint64_t iterations = 1;; iterations *= 2) {
+    auto const start = std::chrono::steady_clock::now();
+    for (std::uint64_t i = 0; i < iterations; ++i) {
+      body();
+    }
+    auto const time = std::chrono::steady_clock::now() - start;
+    if (time >= MIN_BENCH_TIME) {
+      return seconds(time) * 1e9 / static_cast<double>(iterations * operations);
+    }
+  }
+}
+
+int verify() {
+  bool passed = true;
+  for (auto const &position : POSITIONS) {
+    bool position_passed = true;
+    chess::Board board(position.fen);
+    for (int depth = 1; depth <= static_cast<int>(position.nodes.size()); ++depth) {
+      auto const expected = position.nodes[depth - 1];
+      auto const nodes    = perft(board, depth);
+      if (nodes != expected) {
+        std::cout << position.name << " depth " << depth << ": " << nodes << " nodes, expected "
+                  << expected << '\n';
+        position_passed = false;
+      }
+    }
+    std::cout << position.name << " up to depth " << position.nodes.size() << ' '
+              << (position_passed ? "ok" : "FAILED") << std::endl;
+    passed = passed && position_passed;
+  }
+  return passed ? 0 : 1;
+}
+
+// Every benchmark goes over all the positions, the time is per board, move or square
+void bench() {
+  std::vector<chess::Board> boards;
+  std::vector<chess::Movelist> moves(POSITIONS.size());
+  std::uint64_t total_moves = 0;
+  for (std::size_t i = 0; i < POSITIONS.size(); ++i) {
+    boards.emplace_back(POSITIONS[i].fen);
+    chess::movegen::legalmoves(moves[i], boards[i]);
+    total_moves += static_cast<std::uint64_t>(moves[i].size());
+  }
+  auto const positions = static_cast<std::uint64_t>(boards.size());
+
+  auto const report = [](std::string_view name, std::string_view unit, double nanoseconds) {
+    std::cout << name << ": " << nanoseconds << " ns per " << unit << ", "
+              << static_cast<std::uint64_t>(1e9 / nanoseconds) << " per second" << std::endl;
+  };
+
+  report("legal moves", "position", nanosecondsPerOperation(positions, [&] {
+           chess::Movelist list;
+           for (auto const &board : boards) {
+             chess::movegen::legalmoves(list, board);
+             doNotOptimize(list);
+           }
+         }));
+  report("captures", "position", nanosecondsPerOperation(positions, [&] {
+           chess::Movelist list;
+           for (auto const &board : boards) {
+             chess::movegen::legalmoves<chess::movegen::MoveGenType::CAPTURE>(list, board);
+             doNotOptimize(list);
+           }
+         }));
+  // The hash is updated incrementally by makeMove, so this includes its cost
+  report("make and unmake", "move", nanosecondsPerOperation(total_moves, [&] {
+           for (std::size_t i = 0; i < boards.size(); ++i) {
+             for (auto const &move : moves[i]) {
+               boards[i].makeMove(move);
+               doNotOptimize(boards[i].hash());
+               boards[i].unmakeMove(move);
+             }
+           }
+         }));
+  report("attacked", "square", nanosecondsPerOperation(positions * 64 * 2, [&] {
+           for (auto const &board : boards) {
+             for (int square = 0; square < 64; ++square) {
+               doNotOptimize(board.isAttacked(chess::Square(square), chess::Color::WHITE));
+               doNotOptimize(board.isAttacked(chess::Square(square), chess::Color::BLACK));
+             }
+           }
+         }));
+  report("full hash", "position", nanosecondsPerOperation(positions, [&] {
+           for (auto const &board : boards) {
+             doNotOptimize(board.zobrist());
+           }
+         }));
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  bool divide_moves = false;
+  int depth         = 0;
+  std::string fen;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view const arg = argv[i];
+    if (arg == "--verify") {
+      return verify();
+    }
+    if (arg == "--bench") {
+      bench();
+      return 0;
+    }
+    if (arg == "--divide") {
+      divide_moves = true;
+    } else if (depth == 0) {
+      depth = std::atoi(argv[i]);
+    } else {
+      // The FEN may be passed as one argument or as its fields
+      fen += (fen.empty() ? "" : " ") + std::string(arg);
+    }
+  }
+  if (depth <= 0) {
+    std::cerr << "Usage: perft [--divide] <depth> [fen] | --verify | --bench\n";
+    return 1;
+  }
+
+  chess::Board board(fen.empty() ? chess::constants::STARTPOS : fen);
+  auto const start = std::chrono::steady_clock::now();
+  auto const nodes = divide_moves ? divide(board, depth) : perft(board, depth);
+  auto const time  = seconds(std::chrono::steady_clock::now() - start);
+  std::cout << "Nodes: " << nodes << "\nTime: " << time << " s\nNPS: "
+            << static_cast<std::uint64_t>(static_cast<double>(nodes) / std::max(time, 1e-9))
+            << std::endl;
+  return 0;
+}
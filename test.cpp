@@ -2,6 +2,7 @@
 #include <chrono>
 #include <climits> // For INT_MIN and INT_MAX
 #include <iostream>
+#include <string_view>
 #include <thread>
 
 #include "bot.hpp"
@@ -11,49 +12,58 @@
 #include <chess.hpp>
 // ---
 
-int main() {
+// The bot plays white unless "black" is passed, the opponent always plays its first legal move
+int main(int argc, char **argv) {
   chess::Board board;
   Bot bot;
 
+  auto const bot_color = argc > 1 && std::string_view(argv[1]) == "black"
+                             ? chess::Color(chess::Color::BLACK)
+                             : chess::Color(chess::Color::WHITE);
+
   int n_turns           = 0;
+  SearchStats stats;
   auto const start_time = std::chrono::high_resolution_clock::now();
   while (board.isGameOver().second == chess::GameResult::NONE) {
-    ++n_turns;
-
-    auto const best_white_move = bot.findBestWhiteMove(board.getFen());
+    if (board.sideToMove() == bot_color) {
+      ++n_turns;
 
-    if (best_white_move.move == chess::Move::NO_MOVE) {
-      break;
-    }
+      auto const best_move = bot.findBestMove(board.getFen());
+      stats += best_move.stats;
 
-    board.makeMove(best_white_move.move);
-    std::cout << "White plays: " << best_white_move.move
-              << "    evaluation: " << evaluateBoard(board)
-              << "    side to move: " << board.sideToMove()
-              << " best_eval: " << best_white_move.eval << '\n';
+      if (best_move.move == chess::Move::NO_MOVE) {
+        break;
+      }
 
-    // Check if game is over after White's move
-    if (board.isGameOver().second != chess::GameResult::NONE) {
-      break;
+      board.makeMove(best_move.move);
+      std::cout << "Bot plays: " << best_move.move << "    evaluation: " << evaluateBoard(board)
+                << "    side to move: " << board.sideToMove() << " best_eval: " << best_move.eval
+                << '\n';
+      continue;
     }
 
-    // Black's turn (selects the first legal move)
-    chess::Movelist black_moves;
-    chess::movegen::legalmoves(black_moves, board);
+    // Opponent's turn (selects the first legal move)
+    chess::Movelist opponent_moves;
+    chess::movegen::legalmoves(opponent_moves, board);
 
-    if (black_moves.empty()) {
+    if (opponent_moves.empty()) {
       break; // No legal moves, game over
     }
 
-    // Make the first move for Black
-    board.makeMove(black_moves[0]);
-    std::cout << "Black plays: " << black_moves[0] << "    evaluation: " << evaluateBoard(board)
+    board.makeMove(opponent_moves[0]);
+    std::cout << "Opponent plays: " << opponent_moves[0]
+              << "    evaluation: " << evaluateBoard(board)
               << "    side to move: " << board.sideToMove() << '\n';
   }
 
   auto const end_time = std::chrono::high_resolution_clock::now();
   auto const duration = std::chrono::duration_cast<std::chrono::seconds>(end_time - start_time);
 
+  std::cout << "Searched " << stats.nodes << " nodes (" << stats.qnodes << " in quiescence) at "
+            << stats.nps() << " nps. TT hits: " << stats.ttHitRate() * 100
+            << "%, TT cutoffs: " << stats.ttCutoffRate() * 100
+            << "%, first move cutoffs: " << stats.firstMoveCutoffRate() * 100 << "%\n";
+
   // Display game result
   auto const game_over = board.isGameOver();
   std::cout << "Game over in " << n_turns << ". Took " << duration.count() << " seconds. "
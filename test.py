@@ -60,8 +60,9 @@ class BotWorker(QObject):
 class ChessBoardWidget(QSvgWidget):
     squareClicked = pyqtSignal(str)  # Signal to emit when a move is made
 
-    def __init__(self, parent=None):
+    def __init__(self, flipped, parent=None):
         super().__init__(parent)
+        self.flipped = flipped
         self.setMouseTracking(True)
         self.start_square = None
         self.end_square = None
@@ -92,8 +93,12 @@ class ChessBoardWidget(QSvgWidget):
         rank_index = int(y / square_size)
 
         # Adjust for flipped board
-        file_number = 7 - file_index
-        rank_number = rank_index
+        if self.flipped:
+            file_number = 7 - file_index
+            rank_number = rank_index
+        else:
+            file_number = file_index
+            rank_number = 7 - rank_index
 
         if 0 <= file_number <= 7 and 0 <= rank_number <= 7:
             square_index = chess.square(file_number, rank_number)
@@ -103,9 +108,11 @@ class ChessBoardWidget(QSvgWidget):
 
 
 class ChessGUI(QWidget):
-    def __init__(self, bot_path):
+    def __init__(self, bot_path, human_color=chess.BLACK):
         super().__init__()
-        self.setWindowTitle("Chess GUI - Play as Black")
+        self.human_color = human_color
+        self.setWindowTitle("Chess GUI - Play as " +
+                            ("White" if human_color == chess.WHITE else "Black"))
         self.setGeometry(100, 100, 600, 700)
 
         self.bot = ChessBot(bot_path)
@@ -115,7 +122,7 @@ class ChessGUI(QWidget):
         self.layout = QVBoxLayout(self)
 
         # SVG Widget for chessboard
-        self.svg_widget = ChessBoardWidget(self)
+        self.svg_widget = ChessBoardWidget(human_color == chess.BLACK, self)
         self.svg_widget.setFixedSize(600, 600)
         self.layout.addWidget(self.svg_widget)
 
@@ -136,13 +143,14 @@ class ChessGUI(QWidget):
         # Render the initial board
         self.update_board()
 
-        # AI makes the first move
-        self.bot_move()
+        # AI makes the first move when it plays white
+        if self.board.turn != self.human_color:
+            self.bot_move()
 
     def update_board(self):
         """Update the chessboard display."""
-        svg_data = chess.svg.board(self.board, flipped=True).encode(
-            "utf-8")  # Flipped for Black
+        svg_data = chess.svg.board(
+            self.board, flipped=self.svg_widget.flipped).encode("utf-8")
         self.svg_widget.load(svg_data)
 
     def set_input_enabled(self, enabled):
@@ -239,7 +247,9 @@ if __name__ == "__main__":
     import sys
 
     bot_path = "C:/Users/rober/Documents/code/chess_ai/build/Release/chess_ai.exe"
+    # Pass "white" to play the white pieces, the bot takes the other side
+    human_color = chess.WHITE if "white" in sys.argv[1:] else chess.BLACK
     app = QApplication(sys.argv)
-    chess_gui = ChessGUI(bot_path)
+    chess_gui = ChessGUI(bot_path, human_color)
     chess_gui.show()
     sys.exit(app.exec_())